@@ -0,0 +1,46 @@
+#!/usr/bin/env python
+#
+# Generates the emoji lookup table compiled into MessageFormatter from
+# emoji.json. Usage: emojitable.py <emoji.json> <output header>
+
+import json
+import sys
+
+
+def main(source, target):
+    with open(source) as f:
+        emojis = json.load(f)
+
+    entries = sorted((e["name"], e["image"]) for e in emojis)
+
+    lines = [
+        "// Generated from emoji.json by emojitable.py, do not edit",
+        "#ifndef EMOJITABLE_H",
+        "#define EMOJITABLE_H",
+        "",
+        "struct EmojiEntry",
+        "{",
+        "    const char *name;",
+        "    const char *image;",
+        "};",
+        "",
+        "// Sorted by name",
+        "static const EmojiEntry emojiTable[] = {",
+    ]
+    for name, image in entries:
+        lines.append('    { "%s", "%s" },' % (name, image))
+    lines += [
+        "};",
+        "",
+        "static const int emojiTableSize = %d;" % len(entries),
+        "",
+        "#endif // EMOJITABLE_H",
+        "",
+    ]
+
+    with open(target, "w") as f:
+        f.write("\n".join(lines))
+
+
+if __name__ == "__main__":
+    main(sys.argv[1], sys.argv[2])
@@ -29,6 +29,16 @@ QT += concurrent
 
 include(vendor/vendor.pri)
 
+# Emoji lookup table generated from data/emoji.json
+EMOJI_JSON = data/emoji.json
+emojitable.input = EMOJI_JSON
+emojitable.output = $$OUT_PWD/emojitable.h
+emojitable.commands = python $$PWD/data/emojitable.py ${QMAKE_FILE_IN} ${QMAKE_FILE_OUT}
+emojitable.variable_out = HEADERS
+emojitable.CONFIG += no_link target_predeps
+QMAKE_EXTRA_COMPILERS += emojitable
+INCLUDEPATH += $$OUT_PWD
+
 VERSION = "1.4.2"
 DEFINES += APP_VERSION=\\\"$${VERSION}\\\"
 
@@ -59,7 +69,14 @@ SOURCES += src/harbour-slackfish.cpp \
     src/messageformatter.cpp \
     src/notificationlistener.cpp \
     src/dbusadaptor.cpp \
-    src/filemodel.cpp
+    src/filemodel.cpp \
+    src/requestscheduler.cpp \
+    src/workerpipeline.cpp \
+    src/channellistmodel.cpp \
+    src/messagelistmodel.cpp \
+    src/contentcache.cpp \
+    src/slacktimestamp.cpp \
+    src/reconnectpolicy.cpp
 
 OTHER_FILES += qml/harbour-slackfish.qml \
     qml/cover/CoverPage.qml \
@@ -84,14 +101,20 @@ HEADERS += \
     src/messageformatter.h \
     src/notificationlistener.h \
     src/dbusadaptor.h \
-    src/filemodel.h
+    src/filemodel.h \
+    src/requestscheduler.h \
+    src/workerpipeline.h \
+    src/channellistmodel.h \
+    src/messagelistmodel.h \
+    src/contentcache.h \
+    src/slacktimestamp.h \
+    src/reconnectpolicy.h
 
 DISTFILES += \
     qml/pages/Settings.js \
     qml/pages/LoginPage.qml \
     qml/pages/Loader.qml \
     qml/pages/ChannelList.qml \
-    qml/pages/ChannelList.js \
     qml/pages/Channel.qml \
     qml/pages/MessageListItem.qml \
     qml/pages/MessageInput.qml \
@@ -110,7 +133,5 @@ DISTFILES += \
     qml/pages/ChatSelect.qml \
     qml/dialogs/ImagePicker.qml \
     qml/pages/FileSend.qml \
-    data/emoji.json
-
-RESOURCES += \
-    data.qrc
+    data/emoji.json \
+    data/emojitable.py
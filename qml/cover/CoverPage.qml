@@ -4,7 +4,7 @@ import harbour.slackfish 1.0 as Slack
 import "../pages/Settings.js" as Settings
 
 CoverBackground {
-    property int unreadMessageCount: 0
+    property int unreadMessageCount: Slack.Client.channelListModel.unreadCount
     property color unreadColor: unreadMessageCount === 0 ? Theme.secondaryColor : Theme.primaryColor
 
     Label {
@@ -74,8 +74,8 @@ CoverBackground {
     }
 
     Component.onCompleted: {
-        Slack.Client.onInitSuccess.connect(reloadChannelList)
-        Slack.Client.onChannelUpdated.connect(reloadChannelList)
+        Slack.Client.onInitSuccess.connect(updateTitle)
+        Slack.Client.onSnapshotRestored.connect(updateTitle)
         Slack.Client.onConnected.connect(hideConnectionMessage)
         Slack.Client.onReconnecting.connect(showReconnectingMessage)
         Slack.Client.onDisconnected.connect(showDisconnectedMessage)
@@ -108,14 +108,7 @@ CoverBackground {
         disconnectedActions.enabled = false
     }
 
-    function reloadChannelList() {
+    function updateTitle() {
         title.text = Settings.getUserInfo().teamName
-        unreadMessageCount = 0
-
-        Slack.Client.getChannels().forEach(function(channel) {
-            if (channel.isOpen && channel.unreadCount > 0) {
-                unreadMessageCount += channel.unreadCount
-            }
-        })
     }
 }
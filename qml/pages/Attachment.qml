@@ -64,9 +64,9 @@ Column {
                 Image {
                     width: parent.width
                     fillMode: Image.PreserveAspectFit
-                    source: model.url
-                    sourceSize.width: model.size.width
-                    sourceSize.height: model.size.height
+                    source: modelData.url
+                    sourceSize.width: modelData.size.width
+                    sourceSize.height: modelData.size.height
                 }
             }
         }
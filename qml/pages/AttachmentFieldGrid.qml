@@ -13,12 +13,12 @@ GridLayout {
         id: repeater
 
         RichTextLabel {
-            Layout.columnSpan: model.isShort ? 1 : 2
-            Layout.preferredWidth: model.isShort ? grid.width / 2 : grid.width
+            Layout.columnSpan: modelData.isShort ? 1 : 2
+            Layout.preferredWidth: modelData.isShort ? grid.width / 2 : grid.width
             Layout.alignment: Qt.AlignTop | Qt.AlignLeft
             font.pixelSize: Theme.fontSizeExtraSmall
-            font.weight: model.isTitle ? Font.Bold : Font.Normal
-            value: model.content
+            font.weight: modelData.isTitle ? Font.Bold : Font.Normal
+            value: modelData.content
         }
     }
 }
@@ -3,7 +3,6 @@ import Sailfish.Silica 1.0
 import harbour.slackfish 1.0 as Slack
 
 import "Settings.js" as Settings
-import "ChannelList.js" as ChannelList
 import "Channel.js" as Channel
 
 SilicaListView {
@@ -16,9 +15,7 @@ SilicaListView {
         title: Settings.getUserInfo().teamName
     }
 
-    model: ListModel {
-        id: channelListModel
-    }
+    model: Slack.Client.channelListModel
 
     section {
         property: "section"
@@ -89,14 +86,6 @@ SilicaListView {
         }
     }
 
-    Component.onCompleted: {
-        ChannelList.init()
-    }
-
-    Component.onDestruction: {
-        ChannelList.disconnect()
-    }
-
     function getSectionName(section) {
         switch (section) {
             case "unread":
@@ -7,6 +7,7 @@ Page {
     id: page
 
     property bool firstView: true
+    property bool initialized: false
     property bool loading: true
     property string errorMessage: ""
     property string loadMessage: ""
@@ -84,6 +85,7 @@ Page {
         Slack.Client.onTestLoginSuccess.connect(handleLoginTestSuccess)
         Slack.Client.onTestLoginFail.connect(handleLoginTestFail)
         Slack.Client.onInitSuccess.connect(handleInitSuccess)
+        Slack.Client.onSnapshotRestored.connect(handleInitSuccess)
         Slack.Client.onInitFail.connect(handleInitFail)
         Slack.Client.onTestConnectionFail.connect(handleConnectionFail)
     }
@@ -92,6 +94,7 @@ Page {
         Slack.Client.onTestLoginSuccess.disconnect(handleLoginTestSuccess)
         Slack.Client.onTestLoginFail.disconnect(handleLoginTestFail)
         Slack.Client.onInitSuccess.disconnect(handleInitSuccess)
+        Slack.Client.onSnapshotRestored.disconnect(handleInitSuccess)
         Slack.Client.onInitFail.disconnect(handleInitFail)
         Slack.Client.onTestConnectionFail.disconnect(handleConnectionFail)
     }
@@ -119,7 +122,12 @@ Page {
     }
 
     function handleInitSuccess() {
-        pageStack.replace(Qt.resolvedUrl("ChannelList.qml"))
+        // A restored snapshot shows the channel list before the connection
+        // is up, the following initSuccess must not replace it again
+        if (!initialized) {
+            initialized = true
+            pageStack.replace(Qt.resolvedUrl("ChannelList.qml"))
+        }
     }
 
     function handleInitFail() {
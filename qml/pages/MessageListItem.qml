@@ -55,16 +55,16 @@ ListItem {
 
             Image {
                 width: parent.width
-                height: model.thumbSize.height
+                height: modelData.thumbSize.height
                 fillMode: Image.PreserveAspectFit
-                source: model.thumbUrl
-                sourceSize.width: model.thumbSize.width
-                sourceSize.height: model.thumbSize.height
+                source: modelData.thumbUrl
+                sourceSize.width: modelData.thumbSize.width
+                sourceSize.height: modelData.thumbSize.height
 
                 MouseArea {
                     anchors.fill: parent
                     onClicked: {
-                        pageStack.push(Qt.resolvedUrl("Image.qml"), {"model": model})
+                        pageStack.push(Qt.resolvedUrl("Image.qml"), {"model": modelData})
                     }
                 }
             }
@@ -76,7 +76,7 @@ ListItem {
 
             Attachment {
                 width: column.width
-                attachment: model
+                attachment: modelData
                 onLinkClicked: handleLink(link)
             }
         }
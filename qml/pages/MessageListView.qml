@@ -12,6 +12,8 @@ SilicaListView {
     property bool loading: false
     property bool canLoadMore: hasMoreMessages && !loading
     property string latestRead: ""
+    property real lastContentY: 0
+    property variant messageListModel: channel ? Slack.Client.messageListModel(channel.id) : null
 
     signal loadCompleted()
     signal loadStarted()
@@ -43,35 +45,11 @@ SilicaListView {
         }
     }
 
-    WorkerScript {
-        id: loader
-        source: "MessageLoader.js"
-
-        onMessage: {
-            if (messageObject.op === 'replace') {
-                listView.positionViewAtEnd()
-                inputEnabled = true
-                loading = false
-                loadCompleted()
-
-                if (messageListModel.count) {
-                    latestRead = messageListModel.get(messageListModel.count - 1).timestamp
-                    readTimer.restart()
-                }
-            }
-            else if (messageObject.op === 'prepend') {
-                loading = false
-            }
-        }
-    }
-
     header: PageHeader {
         title: channel.name
     }
 
-    model: ListModel {
-        id: messageListModel
-    }
+    model: messageListModel
 
     delegate: MessageListItem {}
 
@@ -104,6 +82,9 @@ SilicaListView {
         if (canLoadMore && y < Screen.height / 3) {
             loadHistory()
         }
+
+        prefetchMessages(contentY < lastContentY ? -1 : 1)
+        lastContentY = contentY
     }
 
     onMovementEnded: {
@@ -125,6 +106,10 @@ SilicaListView {
         Slack.Client.onLoadMessagesSuccess.disconnect(handleLoadSuccess)
         Slack.Client.onLoadHistorySuccess.disconnect(handleHistorySuccess)
         Slack.Client.onMessageReceived.disconnect(handleMessageReceived)
+
+        if (channel) {
+            Slack.Client.cancelLoads(channel.id)
+        }
     }
 
     function markLatest() {
@@ -140,6 +125,18 @@ SilicaListView {
         loadMessages()
     }
 
+    function prefetchMessages(direction) {
+        if (!messageListModel) {
+            return
+        }
+
+        var first = indexAt(0, contentY)
+        var last = indexAt(0, contentY + height - 1)
+        if (first >= 0 && last >= 0) {
+            messageListModel.prefetch(first, last, direction)
+        }
+    }
+
     function loadMessages() {
         loading = true
         Slack.Client.loadMessages(channel.type, channel.id)
@@ -152,32 +149,33 @@ SilicaListView {
         }
     }
 
-    function handleLoadSuccess(channelId, messages, hasMore) {
+    function handleLoadSuccess(channelId, hasMore) {
         if (channelId === channel.id) {
             hasMoreMessages = hasMore
-            loader.sendMessage({
-                op: 'replace',
-                model: messageListModel,
-                messages: messages
-            })
+            listView.positionViewAtEnd()
+            inputEnabled = true
+            loading = false
+            loadCompleted()
+
+            if (messageListModel.count) {
+                latestRead = messageListModel.get(messageListModel.count - 1).timestamp
+                readTimer.restart()
+            }
         }
     }
 
-    function handleHistorySuccess(channelId, messages, hasMore) {
+    function handleHistorySuccess(channelId, hasMore) {
         if (channelId === channel.id) {
             hasMoreMessages = hasMore
-            loader.sendMessage({
-                op: 'prepend',
-                model: messageListModel,
-                messages: messages
-            })
+            loading = false
         }
     }
 
     function handleMessageReceived(message) {
         if (message.type === "message" && message.channel === channel.id) {
+            // The message is already in messageListModel, but the view only
+            // lays it out on the next polish, so atBottom is still current
             var isAtBottom = atBottom
-            messageListModel.append(message)
 
             if (isAtBottom) {
                 listView.positionViewAtEnd()
@@ -27,6 +27,7 @@ BuildRequires:  pkgconfig(Qt5Qml)
 BuildRequires:  pkgconfig(Qt5Quick)
 BuildRequires:  pkgconfig(Qt5DBus)
 BuildRequires:  pkgconfig(nemonotifications-qt5) >= 1.0.4
+BuildRequires:  python
 BuildRequires:  desktop-file-utils
 
 %description
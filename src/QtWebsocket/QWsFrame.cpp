@@ -19,6 +19,7 @@ along with QtWebsocket.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "QWsFrame.h"
 #include "QWsSocket.h"
+#include "functions.h"
 
 namespace QtWebsocket
 {
@@ -28,30 +29,38 @@ QWsFrame::QWsFrame() :
 	final(false),
 	rsv(0),
 	hasMask(false),
-	payloadLength(0)
+	payloadLength(0),
+	payloadRead(0)
 {}
 
 
 void QWsFrame::clear()
 {
 	payload.clear();
+	payloadRead = 0;
 	readingState = HeaderPending;
 }
 
 
 QByteArray QWsFrame::data() const
 {
-	QByteArray result;
-	result.reserve(payload.size());
 	if (hasMask) {
-		for (int i=0 ; i<payload.size() ; i++)
-			result[i] = (payload[i] ^ maskingKey[i % 4]);
+		QByteArray result(payload.constData(), payload.size());
+		applyMask(result.data(), result.size(), maskingKey);
 		return result;
 	}
 	else
 		return payload;
 }
 
+void QWsFrame::unmask()
+{
+	if (hasMask) {
+		applyMask(payload.data(), payload.size(), maskingKey);
+		hasMask = false;
+	}
+}
+
 bool QWsFrame::controlFrame() const
 {
 	return opcode >= 0x8;
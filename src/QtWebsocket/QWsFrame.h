@@ -56,6 +56,12 @@ public:
   QByteArray data() const;
 
 
+  /*!
+   * Unmasks the payload in place, after which data() returns it without copying
+   */
+  void unmask();
+
+
   /*!
    * Returns true if the opcode is a control code
    */
@@ -72,6 +78,7 @@ public:
   bool hasMask;
   Opcode opcode;
   qint64 payloadLength;
+  qint64 payloadRead;
   char maskingKey[4];
   QByteArray payload;
 };
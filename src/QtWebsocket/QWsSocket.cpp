@@ -28,6 +28,8 @@ along with QtWebsocket.  If not, see <http://www.gnu.org/licenses/>.
 #include <QDebug>
 
 #include <iostream>
+#include <climits>
+#include <cstring>
 
 #include "QWsServer.h"
 #include "QWsFrame.h"
@@ -53,6 +55,9 @@ QWsSocket::QWsSocket(QObject* parent, QTcpSocket* socket, EWebsocketVersion ws_v
 	_wsMode(WsClientMode),
 	_currentFrame(new QWsFrame),
 	continuation(false),
+	payloadToSkip(0),
+	_maxMessageSize(defaultMaxMessageSize),
+	_maxFrameSize(0),
 	_version(ws_v),
 	_hostPort(-1),
 	closingHandshakeSent(false),
@@ -200,6 +205,8 @@ void QWsSocket::connectToHost(const QString& hostName, quint16 port, OpenMode mo
 
 void QWsSocket::connectToHost(const QHostAddress& address, quint16 port, OpenMode mode)
 {
+	payloadToSkip = 0;
+
 	if (!_secured)
 	{
 		handshakeResponse.clear();
@@ -332,6 +339,11 @@ qint64 QWsSocket::write(const QByteArray& byteArray)
 	return QWsSocket::internalWrite(byteArray, true);
 }
 
+qint64 QWsSocket::writeText(const QByteArray& utf8)
+{
+	return QWsSocket::internalWrite(utf8, false);
+}
+
 qint64 QWsSocket::internalWrite(const QByteArray& byteArray, bool asBinary)
 {
 	if (_version == WS_V0)
@@ -357,9 +369,9 @@ qint64 QWsSocket::internalWrite(const QByteArray& byteArray, bool asBinary)
 	}
 	
 	Opcode opcode = (asBinary ? OpBinary : OpText);
-	const QList<QByteArray>& framesList = QWsSocket::composeFrames(byteArray, opcode, maskingKey, maxBytesPerFrame);
+	const QByteArray& frames = QWsSocket::composeFrames(byteArray, opcode, maskingKey, _maxFrameSize);
 
-	if(writeFrames(framesList) != -1)
+	if(writeFrame(frames) != -1)
 	{
 		emit bytesWritten(byteArray.size());
 		return byteArray.size();
@@ -495,6 +507,16 @@ void QWsSocket::processDataV4()
 
 	while (true)
 	{
+		while (payloadToSkip > 0)
+		{
+			qint64 size = qMin<qint64>(qMin(payloadToSkip, tcpSocket->bytesAvailable()), 65536);
+			if (size <= 0)
+			{
+				return;
+			}
+			payloadToSkip -= tcpSocket->read(size).size();
+		}
+
 		switch (_currentFrame->readingState)
 		{
 			case HeaderPending:
@@ -558,77 +580,69 @@ void QWsSocket::processDataV4()
 			};
 			case MaskPending:
 			{
-				if (!_currentFrame->hasMask)
+				if (_currentFrame->hasMask)
 				{
-					_currentFrame->readingState = PayloadBodyPending;
-					break;
-				}
+					if (tcpSocket->bytesAvailable() < 4)
+					{
+						return;
+					}
 
-				if (tcpSocket->bytesAvailable() < 4)
-				{
-					return;
+					tcpSocket->read(_currentFrame->maskingKey, 4); // XXX: Handle return value
 				}
 
-				tcpSocket->read(_currentFrame->maskingKey, 4); // XXX: Handle return value
-
-				/*if (opcode == OpClose)
+				if (!startPayload())
 				{
-					_currentFrame->readingState = CloseDataPending;
+					continue;
 				}
-				else
-				{*/
-					_currentFrame->readingState = PayloadBodyPending;
-				//}
-				//break; //// Intentional fall-through ////
+
+				_currentFrame->readingState = PayloadBodyPending;
+				break;
 			};
 			case PayloadBodyPending:
 			{
-				// TODO: Handle large payloads
-				if (tcpSocket->bytesAvailable() < _currentFrame->payloadLength)
-				{
-					return;
-				}
-
-				_currentFrame->payload = tcpSocket->read(_currentFrame->payloadLength);
-				currentFrame.append(_currentFrame->data());
-
-				currentOpcode = _currentFrame->opcode;
-				if (!_currentFrame->valid())
+				if (_currentFrame->controlFrame())
 				{
-					_currentFrame->clear();
-					if (currentOpcode == OpClose)
+					// Control frames are at most 125 bytes, read them at once
+					if (tcpSocket->bytesAvailable() < _currentFrame->payloadLength)
 					{
-						closingHandshakeReceived = true;
+						return;
 					}
-					close(CloseProtocolError);
-					continue;
-				}
 
-				if (_currentFrame->controlFrame())
-				{
+					_currentFrame->payload = tcpSocket->read(_currentFrame->payloadLength);
+					_currentFrame->unmask();
 					handleControlFrame();
+					_currentFrame->clear();
+					break;
 				}
-				else
+
+				// Data frames are read as they arrive, straight into the
+				// message buffer reserved by startPayload()
+				qint64 remaining = _currentFrame->payloadLength - _currentFrame->payloadRead;
+				qint64 available = qMin(tcpSocket->bytesAvailable(), remaining);
+				if (available > 0)
 				{
-					if (currentOpcode != OpContinue)
+					int offset = currentData.size();
+					currentData.resize(offset + available);
+					qint64 bytesRead = tcpSocket->read(currentData.data() + offset, available);
+					if (bytesRead < available)
 					{
-						currentDataOpcode = _currentFrame->opcode;
+						currentData.resize(offset + qMax<qint64>(bytesRead, 0));
 					}
-
-					if ((currentOpcode == OpContinue && !continuation) || (currentOpcode != OpContinue && continuation))
+					if (bytesRead > 0 && _currentFrame->hasMask)
 					{
-						_currentFrame->clear();
-						close(CloseProtocolError);
-						continue;
+						applyMask(currentData.data() + offset, bytesRead, _currentFrame->maskingKey, _currentFrame->payloadRead);
 					}
+					_currentFrame->payloadRead += qMax<qint64>(bytesRead, 0);
+				}
 
-					continuation = !_currentFrame->final;
-					currentData.append(_currentFrame->data());
+				if (_currentFrame->payloadRead < _currentFrame->payloadLength)
+				{
+					return;
+				}
 
-					if (_currentFrame->final)
-					{
-						handleData();
-					}
+				if (_currentFrame->final)
+				{
+					handleData();
 				}
 
 				_currentFrame->clear();
@@ -648,6 +662,57 @@ void QWsSocket::processDataV4()
 	}
 }
 
+bool QWsSocket::startPayload()
+{
+	// On failure the payload has not been read yet and must be skipped
+	qint64 payloadLength = _currentFrame->payloadLength;
+
+	currentOpcode = _currentFrame->opcode;
+	if (!_currentFrame->valid())
+	{
+		payloadToSkip = payloadLength;
+		_currentFrame->clear();
+		if (currentOpcode == OpClose)
+		{
+			closingHandshakeReceived = true;
+		}
+		close(CloseProtocolError);
+		return false;
+	}
+
+	if (_currentFrame->controlFrame())
+	{
+		return true;
+	}
+
+	if (currentOpcode != OpContinue)
+	{
+		currentDataOpcode = _currentFrame->opcode;
+	}
+
+	if ((currentOpcode == OpContinue && !continuation) || (currentOpcode != OpContinue && continuation))
+	{
+		payloadToSkip = payloadLength;
+		_currentFrame->clear();
+		close(CloseProtocolError);
+		return false;
+	}
+
+	if (_currentFrame->payloadLength > _maxMessageSize - currentData.size())
+	{
+		payloadToSkip = payloadLength;
+		_currentFrame->clear();
+		currentData.clear();
+		continuation = false;
+		close(CloseTooMuchData);
+		return false;
+	}
+
+	continuation = !_currentFrame->final;
+	currentData.reserve(currentData.size() + _currentFrame->payloadLength);
+	return true;
+}
+
 void QWsSocket::handleData()
 {
 	if (state() == ClosingState)
@@ -662,7 +727,11 @@ void QWsSocket::handleData()
 	}
 	if (currentDataOpcode == OpText)
 	{
-		emit frameReceived(QString::fromUtf8(currentData));
+		emit textFrameReceived(currentData);
+		if (receivers(SIGNAL(frameReceived(QString))) > 0)
+		{
+			emit frameReceived(QString::fromUtf8(currentData));
+		}
 		currentData.clear();
 		return;
 	}
@@ -697,16 +766,6 @@ qint64 QWsSocket::writeFrame(const QByteArray& byteArray)
 	return tcpSocket->write(byteArray); // writes data to internal buffer and returns full size always; then emits signals
 }
 
-qint64 QWsSocket::writeFrames(const QList<QByteArray>& framesList)
-{
-	qint64 nbBytesWritten = 0;
-	for (int i=0 ; i<framesList.size() ; i++)
-	{
-		nbBytesWritten += writeFrame(framesList[i]);
-	}
-	return nbBytesWritten;
-}
-
 void QWsSocket::onEncrypted()
 {
 	if (_wsMode == WsClientMode)
@@ -826,7 +885,7 @@ void QWsSocket::handlePing(QByteArray applicationData)
 		return close(CloseProtocolError);
 	}
 
-	writeFrames(QWsSocket::composeFrames(applicationData, OpPong));
+	writeFrame(QWsSocket::composeFrames(applicationData, OpPong));
 }
 
 QByteArray QWsSocket::generateNonce()
@@ -940,132 +999,92 @@ QByteArray QWsSocket::computeAcceptV4(QByteArray key)
 
 QByteArray QWsSocket::mask(const QByteArray& data, QByteArray& maskingKey)
 {
-	QByteArray result;
-	result.reserve(data.size());
-
-	for (int i=0 ; i<data.size() ; i++)
-	{
-		result[i] = (data[i] ^ maskingKey[i % 4]);
-	}
-
+	QByteArray result(data.constData(), data.size());
+	applyMask(result.data(), result.size(), maskingKey.constData());
 	return result;
 }
 
-QList<QByteArray> QWsSocket::composeFrames(QByteArray data, Opcode opcode, QByteArray maskingKey, int maxFrameBytes)
+QByteArray QWsSocket::composeFrames(const QByteArray& data, Opcode opcode, const QByteArray& maskingKey, int maxFrameBytes)
 {
-	if (maxFrameBytes == 0)
-	{
-		maxFrameBytes = maxBytesPerFrame;
-	}
+	const char* key = (maskingKey.size() == 4) ? maskingKey.constData() : NULL;
+	const int dataSize = data.size();
+
+	// 0 sends everything in one frame
+	int frameBytes = (maxFrameBytes > 0 && maxFrameBytes < dataSize) ? maxFrameBytes : dataSize;
+	int nbFrames = (frameBytes > 0) ? (dataSize + frameBytes - 1) / frameBytes : 1;
 
-	QList<QByteArray> frames;
-	int nbFrames = (data.size() / maxFrameBytes) + 1;
+	// Headers and payloads are written straight into one buffer, which is
+	// trimmed to the actual header sizes at the end
+	QByteArray frames;
+	frames.resize(nbFrames * maxHeaderSize + dataSize);
+	char* out = frames.data();
 
+	int offset = 0;
 	for (int i=0; i<nbFrames; i++)
 	{
-		QByteArray frame;
+		Opcode frameOpcode = (i == 0) ? opcode : OpContinue;
+		bool final = (i == nbFrames-1);
+		int frameSize = qMin(frameBytes, dataSize - offset);
 
-		// opCode
-		Opcode frameOpcode = OpContinue;
-		if (i == 0)
-		{
-			frameOpcode = opcode;
-		}
+		out += QWsSocket::composeHeader(out, final, frameOpcode, frameSize, key);
 
-		// final frame & frame size
-		bool final = false;
-		quint64 frameSize = maxFrameBytes;
-		if (i == nbFrames-1) // for multi-frames
+		memcpy(out, data.constData() + offset, frameSize);
+		if (key)
 		{
-			final = true;
-			frameSize = data.size();
+			applyMask(out, frameSize, key);
 		}
 
-		// Compose and append the header to the frame
-		frame.append(QWsSocket::composeHeader(final, frameOpcode, frameSize, maskingKey));
-		
-		// Application Data
-		QByteArray frameData = data.left(frameSize);
-		data.remove(0, frameSize);
-		
-		// mask frame data if necessary
-		if (maskingKey.size())
-		{
-			frameData = QWsSocket::mask(frameData, maskingKey);
-		}
-
-		// append payload to the frame
-		frame.append(frameData);
-
-		// append frame to framesList
-		frames << frame;
+		out += frameSize;
+		offset += frameSize;
 	}
+
+	frames.resize(out - frames.constData());
 	return frames;
 }
 
 QByteArray QWsSocket::composeHeader(bool end, Opcode opcode, quint64 payloadLength, QByteArray maskingKey)
 {
-	QByteArray BA;
-	quint8 byte;
+	char header[maxHeaderSize];
+	int size = QWsSocket::composeHeader(header, end, opcode, payloadLength, (maskingKey.size() == 4) ? maskingKey.constData() : NULL);
+	return QByteArray(header, size);
+}
+
+int QWsSocket::composeHeader(char* out, bool end, Opcode opcode, quint64 payloadLength, const char* maskingKey)
+{
+	int size = 0;
 
 	// end, RSV1-3, Opcode
-	byte = 0x00;
-	// end
-	if (end)
-	{
-		byte = (byte | 0x80);
-	}
-	// Opcode
-	byte = (byte | opcode);
-	BA.append(byte);
+	out[size++] = (end ? 0x80 : 0x00) | opcode;
 
 	// Mask, PayloadLength
-	byte = 0x00;
-	QByteArray BAsize;
-	// Mask
-	if (maskingKey.size() == 4)
+	quint8 byte = (maskingKey ? 0x80 : 0x00);
+	if (payloadLength <= 125)
 	{
-		byte = (byte | 0x80);
+		out[size++] = (char)(byte | payloadLength);
 	}
-	// PayloadLength
-	if (payloadLength <= 125)
+	// Extended payloadLength, 2 bytes
+	else if (payloadLength <= 0xFFFF)
 	{
-		byte = (byte | payloadLength);
+		out[size++] = byte | 126;
+		qToBigEndian<quint16>(payloadLength, (uchar*)out + size);
+		size += 2;
 	}
-	// Extended payloadLength
+	// Extended payloadLength, 8 bytes
 	else
 	{
-		// 2 bytes
-		if (payloadLength <= 0xFFFF)
-		{
-			byte = (byte | 126);
-			BAsize.append((payloadLength >> 1*8) & 0xFF);
-			BAsize.append((payloadLength >> 0*8) & 0xFF);
-		}
-		// 8 bytes
-		else if (payloadLength <= 0x7FFFFFFF)
-		{
-			byte = (byte | 127);
-			BAsize.append((payloadLength >> 7*8) & 0xFF);
-			BAsize.append((payloadLength >> 6*8) & 0xFF);
-			BAsize.append((payloadLength >> 5*8) & 0xFF);
-			BAsize.append((payloadLength >> 4*8) & 0xFF);
-			BAsize.append((payloadLength >> 3*8) & 0xFF);
-			BAsize.append((payloadLength >> 2*8) & 0xFF);
-			BAsize.append((payloadLength >> 1*8) & 0xFF);
-			BAsize.append((payloadLength >> 0*8) & 0xFF);
-		}
+		out[size++] = byte | 127;
+		qToBigEndian<quint64>(payloadLength, (uchar*)out + size);
+		size += 8;
 	}
-	BA.append(byte);
-	BA.append(BAsize);
 
 	// Masking
-	if (maskingKey.size() == 4)
+	if (maskingKey)
 	{
-		BA.append(maskingKey);
+		memcpy(out + size, maskingKey, 4);
+		size += 4;
 	}
 
-	return BA;
+	return size;
 }
 
 QString QWsSocket::composeOpeningHandShakeV13(QString resourceName, QString host, QByteArray key, QString origin, QString protocol, QString extensions)
@@ -1197,4 +1216,25 @@ QString QWsSocket::extensions()
 	return _extensions;
 }
 
+qint64 QWsSocket::maxMessageSize() const
+{
+	return _maxMessageSize;
+}
+
+int QWsSocket::maxFrameSize() const
+{
+	return _maxFrameSize;
+}
+
+void QWsSocket::setMaxFrameSize(int size)
+{
+	_maxFrameSize = qMax(0, size);
+}
+
+void QWsSocket::setMaxMessageSize(qint64 size)
+{
+	// Messages are collected into a single QByteArray
+	_maxMessageSize = qBound<qint64>(1, size, INT_MAX);
+}
+
 } // namespace QtWebsocket
@@ -68,6 +68,12 @@ public:
 
 	qint64 write(const QString& string); // write data as text
 	qint64 write(const QByteArray & byteArray); // write data as binary
+	qint64 writeText(const QByteArray & utf8); // write UTF-8 encoded data as text
+
+	qint64 maxMessageSize() const;
+	void setMaxMessageSize(qint64 size); // larger incoming messages close the connection
+	int maxFrameSize() const;
+	void setMaxFrameSize(int size); // outgoing messages are split into frames of this size, 0 sends one frame
 
 public slots:
 	void connectToHost(const QString & hostName, quint16 port = 80, OpenMode mode = ReadWrite);
@@ -79,12 +85,12 @@ public slots:
 signals:
 	void frameReceived(QString frame);
 	void frameReceived(QByteArray frame);
+	void textFrameReceived(QByteArray frame); // UTF-8 payload of a text message
 	void pong(quint64 elapsedTime);
 	void encrypted();
 	void sslErrors(const QList<QSslError>& errors);
 
 protected:
-	qint64 writeFrames (const QList<QByteArray>& framesList);
 	qint64 writeFrame (const QByteArray& byteArray);
 	inline qint64 internalWrite(const QByteArray& string, bool asBinary);
 	void initTcpSocket();
@@ -117,6 +123,15 @@ private:
 	 */
 	bool continuation;
 
+	/*!
+	 * Payload bytes of a rejected frame still to be discarded, so that the
+	 * next frame header is read from the right place.
+	 */
+	qint64 payloadToSkip;
+
+	qint64 _maxMessageSize;
+	int _maxFrameSize;
+
 	EWebsocketVersion _version;
 	QString _resourceName;
 	QString _hostName;
@@ -151,6 +166,15 @@ private:
 	 */
 	void handlePing(QByteArray applicationData = QByteArray());
 
+	/*!
+	 * Validates the current frame once its header has been read.
+	 *
+	 * Reserves room in `currentData` for the payload of data frames. Closes
+	 * the connection and returns false if the frame is invalid, out of
+	 * sequence or would make the message larger than `maxMessageSize()`.
+	 */
+	bool startPayload();
+
 	/*!
 	 * Processes the joined payload of the previous frames.
 	 *
@@ -177,8 +201,15 @@ public:
 	static QByteArray computeAcceptV0(QByteArray key1, QByteArray key2, QByteArray thirdPart);
 	static QByteArray computeAcceptV4(QByteArray key);
 	static QByteArray mask(const QByteArray& data, QByteArray& maskingKey);
-	static QList<QByteArray> composeFrames(QByteArray data, Opcode opcode = OpText, QByteArray maskingKey = QByteArray(), int maxFrameBytes = 0);
+	static QByteArray composeFrames(const QByteArray& data, Opcode opcode = OpText, const QByteArray& maskingKey = QByteArray(), int maxFrameBytes = 0);
 	static QByteArray composeHeader(bool end, Opcode opcode, quint64 payloadLength, QByteArray maskingKey = QByteArray());
+
+	/*!
+	 * Writes the frame header to `out`, which must have room for
+	 * `maxHeaderSize` bytes, and returns its size. `maskingKey` is 4 bytes
+	 * or NULL for an unmasked frame.
+	 */
+	static int composeHeader(char* out, bool end, Opcode opcode, quint64 payloadLength, const char* maskingKey);
 	static QString composeOpeningHandShakeV0(QString resourceName, QString host, QByteArray key1, QByteArray key2, QByteArray key3, QString origin = "", QString protocol = "", QString extensions = "");
 	static QString composeOpeningHandShakeV13(QString resourceName, QString host, QByteArray key, QString origin = "", QString protocol = "", QString extensions = "");
 
@@ -191,7 +222,8 @@ public:
 	static QByteArray composeFrame(QByteArray applicationData, Opcode opcode, bool final = true);
 
 	// static vars
-	static const int maxBytesPerFrame = 1400;
+	static const int maxHeaderSize = 14;
+	static const qint64 defaultMaxMessageSize = 16 * 1024 * 1024;
 	static const QLatin1String emptyLine;
 	static QRegExp regExpIPv4;
 	static QRegExp regExpHttpRequest;
@@ -19,6 +19,13 @@ along with QtWebsocket.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <QtCore/qmath.h>
 #include <climits>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
 
 namespace QtWebsocket
 {
@@ -98,4 +105,47 @@ quint64 rand64(quint64 low, quint64 high)
 	return low + (myRand % (high - low + 1));
 }
 
+void applyMask(char* data, qint64 size, const char* maskingKey, qint64 offset)
+{
+	quint8 pattern[16];
+	for (int i = 0; i < 16; i++)
+	{
+		pattern[i] = maskingKey[(offset + i) % 4];
+	}
+
+	qint64 i = 0;
+
+#if defined(__SSE2__)
+	const __m128i mask128 = _mm_loadu_si128((const __m128i*)pattern);
+	for (; i + 16 <= size; i += 16)
+	{
+		__m128i chunk = _mm_loadu_si128((const __m128i*)(data + i));
+		_mm_storeu_si128((__m128i*)(data + i), _mm_xor_si128(chunk, mask128));
+	}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	const uint8x16_t mask128 = vld1q_u8(pattern);
+	for (; i + 16 <= size; i += 16)
+	{
+		uint8x16_t chunk = vld1q_u8((const uint8_t*)(data + i));
+		vst1q_u8((uint8_t*)(data + i), veorq_u8(chunk, mask128));
+	}
+#endif
+
+	// Word at a time for the rest, or everything without SIMD
+	quint64 mask64;
+	memcpy(&mask64, pattern, sizeof(mask64));
+	for (; i + 8 <= size; i += 8)
+	{
+		quint64 chunk;
+		memcpy(&chunk, data + i, sizeof(chunk));
+		chunk ^= mask64;
+		memcpy(data + i, &chunk, sizeof(chunk));
+	}
+
+	for (; i < size; i++)
+	{
+		data[i] ^= pattern[i % 4];
+	}
+}
+
 } // namespace QtWebsocket
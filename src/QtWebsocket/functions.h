@@ -31,6 +31,13 @@ quint16 rand16(quint16 low = 0, quint16 high = 0);
 quint32 rand32(quint32 low = 0, quint32 high = 0);
 quint64 rand64(quint64 low = 0, quint64 high = 0);
 
+/*!
+ * XORs `size` bytes of `data` in place with the 4 byte `maskingKey`, as
+ * described in RFC 6455, Section 5.3. `offset` is the position of
+ * `data[0]` within the masked payload.
+ */
+void applyMask(char* data, qint64 size, const char* maskingKey, qint64 offset = 0);
+
 } // namespace QtWebsocket
 
 #endif // QTWS_FUNCTIONS_H
@@ -0,0 +1,180 @@
+#include "channellistmodel.h"
+
+#include <algorithm>
+
+ChannelListModel::ChannelListModel(QObject *parent) : QAbstractListModel(parent), unread(0) {
+}
+
+QHash<int, QByteArray> ChannelListModel::roleNames() const {
+    QHash<int, QByteArray> roles = QAbstractListModel::roleNames();
+    roles.insert(IdRole, QByteArray("id"));
+    roles.insert(TypeRole, QByteArray("type"));
+    roles.insert(CategoryRole, QByteArray("category"));
+    roles.insert(NameRole, QByteArray("name"));
+    roles.insert(PresenceRole, QByteArray("presence"));
+    roles.insert(IsOpenRole, QByteArray("isOpen"));
+    roles.insert(LastReadRole, QByteArray("lastRead"));
+    roles.insert(UnreadCountRole, QByteArray("unreadCount"));
+    roles.insert(UserIdRole, QByteArray("userId"));
+    roles.insert(SectionRole, QByteArray("section"));
+    return roles;
+}
+
+int ChannelListModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid()) {
+        return 0;
+    }
+
+    return channels.size();
+}
+
+QVariant ChannelListModel::data(const QModelIndex &index, int role) const {
+    if (index.row() < 0 || index.row() >= channels.size()) {
+        return QVariant();
+    }
+
+    const Channel &channel = channels.at(index.row());
+    switch (role) {
+    case IdRole:
+        return channel.id;
+    case TypeRole:
+        return channel.type;
+    case CategoryRole:
+        return channel.category;
+    case NameRole:
+        return channel.name;
+    case PresenceRole:
+        return channel.presence;
+    case IsOpenRole:
+        return channel.isOpen;
+    case LastReadRole:
+        return channel.lastRead;
+    case UnreadCountRole:
+        return channel.unreadCount;
+    case UserIdRole:
+        return channel.userId.isEmpty() ? QVariant() : QVariant(channel.userId);
+    case SectionRole:
+        return channel.unreadCount > 0 ? QString("unread") : channel.category;
+    default:
+        return QVariant();
+    }
+}
+
+int ChannelListModel::unreadCount() const {
+    return unread;
+}
+
+void ChannelListModel::reload() {
+    beginResetModel();
+    channels.clear();
+    int count = 0;
+    foreach (const Channel &channel, Storage::channels()) {
+        if (channel.isOpen) {
+            channels.append(channel);
+            count += channel.unreadCount;
+        }
+    }
+    std::sort(channels.begin(), channels.end(), lessThan);
+    endResetModel();
+
+    setUnreadCount(count);
+}
+
+void ChannelListModel::updateChannels(const QStringList &channelIds) {
+    foreach (const QString &channelId, channelIds) {
+        updateChannel(channelId);
+    }
+}
+
+void ChannelListModel::updateChannel(const QString &channelId) {
+    Channel channel = Storage::channel(channelId);
+    int row = findRow(channelId);
+
+    if (!channel.isValid() || !channel.isOpen) {
+        if (row >= 0) {
+            int count = unread - channels.at(row).unreadCount;
+            beginRemoveRows(QModelIndex(), row, row);
+            channels.removeAt(row);
+            endRemoveRows();
+            setUnreadCount(count);
+        }
+        return;
+    }
+
+    int position = insertPosition(channel);
+
+    if (row < 0) {
+        beginInsertRows(QModelIndex(), position, position);
+        channels.insert(position, channel);
+        endInsertRows();
+        setUnreadCount(unread + channel.unreadCount);
+        return;
+    }
+
+    int count = unread - channels.at(row).unreadCount + channel.unreadCount;
+
+    // Position among the other rows, as if this one had been taken out
+    if (position > row) {
+        position--;
+    }
+
+    if (position != row) {
+        beginMoveRows(QModelIndex(), row, row, QModelIndex(), position > row ? position + 1 : position);
+        channels.move(row, position);
+        endMoveRows();
+    }
+
+    channels[position] = channel;
+    QModelIndex changed = index(position);
+    emit dataChanged(changed, changed);
+
+    setUnreadCount(count);
+}
+
+int ChannelListModel::findRow(const QString &channelId) const {
+    for (int i = 0; i < channels.size(); i++) {
+        if (channels.at(i).id == channelId) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int ChannelListModel::insertPosition(const Channel &channel) const {
+    return std::lower_bound(channels.begin(), channels.end(), channel, lessThan) - channels.begin();
+}
+
+int ChannelListModel::sectionRank(const Channel &channel) {
+    if (channel.unreadCount > 0) {
+        return 0;
+    }
+    else if (channel.category == "channel") {
+        return 1;
+    }
+    else {
+        return 2;
+    }
+}
+
+bool ChannelListModel::lessThan(const Channel &a, const Channel &b) {
+    int rankA = sectionRank(a);
+    int rankB = sectionRank(b);
+    if (rankA != rankB) {
+        return rankA < rankB;
+    }
+
+    int result = QString::localeAwareCompare(a.name, b.name);
+    if (result != 0) {
+        return result < 0;
+    }
+
+    return a.id < b.id;
+}
+
+void ChannelListModel::setUnreadCount(int count) {
+    if (count != unread) {
+        unread = count;
+        emit unreadCountChanged();
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef CHANNELLISTMODEL_H
+#define CHANNELLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QList>
+#include <QStringList>
+#include <QVariantMap>
+
+#include "storage.h"
+
+// Open channels from Storage in channel list order: channels with unread
+// messages first, then channels, then chats, each group sorted by name.
+// A changed channel only updates or moves its own row.
+class ChannelListModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int unreadCount READ unreadCount NOTIFY unreadCountChanged)
+
+public:
+    enum ChannelRoles {
+        IdRole = Qt::UserRole + 1,
+        TypeRole,
+        CategoryRole,
+        NameRole,
+        PresenceRole,
+        IsOpenRole,
+        LastReadRole,
+        UnreadCountRole,
+        UserIdRole,
+        SectionRole
+    };
+
+    explicit ChannelListModel(QObject *parent = 0);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+    int unreadCount() const;
+
+signals:
+    void unreadCountChanged();
+
+public slots:
+    void reload();
+    void updateChannel(const QString &channelId);
+    void updateChannels(const QStringList &channelIds);
+
+protected:
+    QHash<int, QByteArray> roleNames() const;
+
+private:
+    static int sectionRank(const Channel &channel);
+    static bool lessThan(const Channel &a, const Channel &b);
+
+    int findRow(const QString &channelId) const;
+    int insertPosition(const Channel &channel) const;
+    void setUnreadCount(int count);
+
+    QList<Channel> channels;
+    int unread;
+};
+
+#endif // CHANNELLISTMODEL_H
@@ -0,0 +1,48 @@
+#include "contentcache.h"
+
+#include "storage.h"
+
+ContentCache::ContentCache(int maxCost) : cache(maxCost) {
+}
+
+QString ContentCache::key(const QString &channelId, const QString &timestamp, const QString &editedTimestamp) {
+    return channelId + '/' + timestamp + '/' + editedTimestamp;
+}
+
+bool ContentCache::find(const QString &key, QString &content) {
+    QMutexLocker locker(&mutex);
+
+    Entry *entry = cache.object(key);
+    if (!entry) {
+        return false;
+    }
+
+    quint64 current = Storage::directoryGeneration();
+    if (entry->generation != current) {
+        foreach (const QString &id, entry->references) {
+            if (Storage::nameGeneration(id) > entry->generation) {
+                cache.remove(key);
+                return false;
+            }
+        }
+        entry->generation = current;
+    }
+
+    content = entry->content;
+    return true;
+}
+
+void ContentCache::insert(const QString &key, const QString &content, const QStringList &references, quint64 generation) {
+    QMutexLocker locker(&mutex);
+
+    Entry *entry = new Entry;
+    entry->content = content;
+    entry->references = references;
+    entry->generation = generation;
+    cache.insert(key, entry, qMax(1, content.size()));
+}
+
+void ContentCache::clear() {
+    QMutexLocker locker(&mutex);
+    cache.clear();
+}
@@ -0,0 +1,35 @@
+#ifndef CONTENTCACHE_H
+#define CONTENTCACHE_H
+
+#include <QCache>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+// Bounded LRU cache of formatted message content, keyed by channel,
+// message timestamp and edit timestamp. Each entry remembers the user and
+// channel ids its text mentions and is dropped once one of them has been
+// renamed in Storage since the entry was formatted. Used from worker threads.
+class ContentCache
+{
+public:
+    explicit ContentCache(int maxCost = 2 * 1024 * 1024);
+
+    static QString key(const QString &channelId, const QString &timestamp, const QString &editedTimestamp);
+
+    bool find(const QString &key, QString &content);
+    void insert(const QString &key, const QString &content, const QStringList &references, quint64 generation);
+    void clear();
+
+private:
+    struct Entry {
+        QString content;
+        QStringList references;
+        quint64 generation;
+    };
+
+    QMutex mutex;
+    QCache<QString,Entry> cache;
+};
+
+#endif // CONTENTCACHE_H
@@ -7,6 +7,8 @@
 #include "dbusadaptor.h"
 #include "storage.h"
 #include "filemodel.h"
+#include "channellistmodel.h"
+#include "messagelistmodel.h"
 
 static QObject *slack_client_provider(QQmlEngine *engine, QJSEngine *scriptEngine) {
     Q_UNUSED(engine)
@@ -34,6 +36,8 @@ int main(int argc, char *argv[])
     SlackConfig::clearWebViewCache();
 
     qmlRegisterSingletonType<SlackClient>("harbour.slackfish", 1, 0, "Client", slack_client_provider);
+    qmlRegisterUncreatableType<ChannelListModel>("harbour.slackfish", 1, 0, "ChannelListModel", "Use Client.channelListModel");
+    qmlRegisterUncreatableType<MessageListModel>("harbour.slackfish", 1, 0, "MessageListModel", "Use Client.messageListModel()");
 
     view->rootContext()->setContextProperty("applicationVersion", APP_VERSION);
     view->rootContext()->setContextProperty("slackClientId", SLACK_CLIENT_ID);
@@ -53,6 +57,8 @@ int main(int argc, char *argv[])
 
     qDebug() << "Application terminating";
 
+    Storage::saveSnapshot();
+
     delete listener;
 
     return result;
@@ -1,119 +1,448 @@
 #include "messageformatter.h"
 
-#include <QRegularExpression>
-#include <QDebug>
-#include <QFile>
-#include <QJsonDocument>
-#include <QJsonArray>
-#include <QJsonObject>
+#include <QVarLengthArray>
+
+#include <algorithm>
+#include <cstring>
 
 #include "storage.h"
+#include "emojitable.h"
+
+// Emoji names are ASCII, compare them without converting either side
+static int compareEmojiName(const QStringRef &name, const char *other) {
+    int i = 0;
+    for (; i < name.size() && other[i]; i++) {
+        ushort a = name.at(i).unicode();
+        uchar b = other[i];
+        if (a != b) {
+            return a < b ? -1 : 1;
+        }
+    }
 
-static QMap<QString, QString> emojiValues() {
-    Q_INIT_RESOURCE(data);
+    if (i < name.size()) {
+        return 1;
+    }
+    return other[i] ? -1 : 0;
+}
 
-    QFile file;
-    file.setFileName((":/data/data/emoji.json"));
-    file.open(QIODevice::ReadOnly | QIODevice::Text);
-    QString contents = file.readAll();
-    file.close();
-    QJsonDocument d = QJsonDocument::fromJson(contents.toUtf8());
+const char *MessageFormatter::emojiImage(const QStringRef &name) {
+    int low = 0;
+    int high = emojiTableSize - 1;
 
-    QMap<QString,QString> map;
-    foreach (const QJsonValue &value, d.array()) {
-        map.insert(value.toObject().value("name").toString(), value.toObject().value("image").toString());
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        int result = compareEmojiName(name, emojiTable[middle].name);
+
+        if (result == 0) {
+            return emojiTable[middle].image;
+        }
+        else if (result < 0) {
+            high = middle - 1;
+        }
+        else {
+            low = middle + 1;
+        }
     }
-    return map;
+
+    return 0;
 }
 
-QMap<QString,QString> MessageFormatter::emojis = emojiValues();
+// Appends the ids of mentioned users and channels to `references`, if given,
+// whether or not they are known yet
+void MessageFormatter::replaceTokens(QString &message, int types, QStringList *references) {
+    int start = message.indexOf('<');
+    if (start < 0) {
+        return;
+    }
 
-void MessageFormatter::replaceUserInfo(QString &message) {
-    foreach (const QVariant &value, Storage::users()) {
-        QVariantMap user = value.toMap();
-        QString id = user.value("id").toString();
-        QString name = user.value("name").toString();
+    QString result;
+    int position = 0;
 
-        QRegularExpression userIdPattern("<@" + id + "(\\|[^>]+)?>");
-        QString displayName = "<a href=\"slackfish://user/"+ id +"\">@" + name + "</a>";
+    while (start >= 0) {
+        int end = message.indexOf('>', start + 1);
+        if (end < 0) {
+            break;
+        }
 
-        message.replace(userIdPattern, displayName);
+        QString replacement;
+        if (formatToken(message.mid(start + 1, end - start - 1), types, replacement, references)) {
+            if (position == 0) {
+                result.reserve(message.size() + 64);
+            }
+            result.append(message.midRef(position, start - position));
+            result.append(replacement);
+            position = end + 1;
+            start = message.indexOf('<', position);
+        }
+        else {
+            start = message.indexOf('<', start + 1);
+        }
+    }
+
+    if (position > 0) {
+        result.append(message.midRef(position));
+        message = result;
     }
 }
 
-void MessageFormatter::replaceChannelInfo(QString &message) {
-    foreach (const QVariant &value, Storage::channels()) {
-        QVariantMap channel = value.toMap();
-        QString id = channel.value("id").toString();
-        QString name = channel.value("name").toString();
+void MessageFormatter::replaceLinks(QString &message) {
+    replaceTokens(message, LinkToken);
+}
+
+bool MessageFormatter::formatToken(const QString &token, int types, QString &result, QStringList *references) {
+    if (token.isEmpty()) {
+        return false;
+    }
+
+    int pipe = token.indexOf('|');
+    bool hasLabel = pipe >= 0 && pipe < token.size() - 1;
+    QChar prefix = token.at(0);
+
+    if (prefix == '@' && (types & UserToken)) {
+        if (pipe >= 0 && !hasLabel) {
+            return false;
+        }
 
-        QRegularExpression channelIdPattern("<#" + id + "(\\|[^>]+)?>");
-        QString displayName = "<a href=\"slackfish://channel/"+ id +"\">#" + name + "</a>";
+        QString userId = token.mid(1, pipe < 0 ? -1 : pipe - 1);
+        if (references) {
+            references->append(userId);
+        }
+
+        User user = Storage::user(userId);
+        if (!user.isValid()) {
+            return false;
+        }
 
-        message.replace(channelIdPattern, displayName);
+        result = "<a href=\"slackfish://user/" + user.id + "\">@" + user.name + "</a>";
+        return true;
     }
+
+    if (prefix == '#' && (types & ChannelToken)) {
+        if (pipe >= 0 && !hasLabel) {
+            return false;
+        }
+
+        QString channelId = token.mid(1, pipe < 0 ? -1 : pipe - 1);
+        if (references) {
+            references->append(channelId);
+        }
+
+        Channel channel = Storage::channel(channelId);
+        if (!channel.isValid()) {
+            return false;
+        }
+
+        result = "<a href=\"slackfish://channel/" + channel.id + "\">#" + channel.name + "</a>";
+        return true;
+    }
+
+    if (prefix == '!' && (types & TargetToken)) {
+        if (pipe >= 0 && !hasLabel) {
+            return false;
+        }
+
+        QString target = token.mid(1, pipe < 0 ? -1 : pipe - 1);
+        if (target != "here" && target != "channel" && target != "group" && target != "everyone") {
+            return false;
+        }
+
+        QString label = hasLabel ? token.mid(pipe + 1) : "@" + target;
+        result = "<a href=\"slackfish://target/" + target + "\">" + label + "</a>";
+        return true;
+    }
+
+    if (types & LinkToken) {
+        if (token.startsWith("http")) {
+            if (hasLabel && pipe > 4) {
+                result = "<a href=\"" + token.left(pipe) + "\">" + token.mid(pipe + 1) + "</a>";
+                return true;
+            }
+            if (token.size() > 4) {
+                result = "<a href=\"" + token + "\">" + token + "</a>";
+                return true;
+            }
+        }
+        else if (token.startsWith("mailto:") && hasLabel && pipe > 7) {
+            result = "<a href=\"" + token.left(pipe) + "\">" + token.mid(pipe + 1) + "</a>";
+            return true;
+        }
+    }
+
+    return false;
 }
 
-void MessageFormatter::replaceLinks(QString &message) {
-    QRegularExpression labelPattern("<(http[^\\|>]+)\\|([^>]+)>");
-    message.replace(labelPattern, "<a href=\"\\1\">\\2</a>");
+// ASCII whitespace only, like \s without UseUnicodePropertiesOption
+static bool isSpace(QChar c) {
+    ushort u = c.unicode();
+    return u == ' ' || (u >= '\t' && u <= '\r');
+}
 
-    QRegularExpression plainPattern("<(http[^>]+)>");
-    message.replace(plainPattern, "<a href=\"\\1\">\\1</a>");
+static bool isMarkupEnd(QChar c) {
+    return isSpace(c) || c == '.' || c == '?' || c == '!' || c == ',';
+}
 
-    QRegularExpression mailtoPattern("<(mailto:[^\\|>]+)\\|([^>]+)>");
-    message.replace(mailtoPattern, "<a href=\"\\1\">\\2</a>");
+static int markupKind(QChar c) {
+    switch (c.unicode()) {
+    case '_': return 0;
+    case '*': return 1;
+    case '~': return 2;
+    case '`': return 3;
+    default: return -1;
+    }
 }
 
-void MessageFormatter::replaceMarkdown(QString &message) {
-    QRegularExpression italicPattern("(^|\\s)_([^_]+)_(\\s|\\.|\\?|!|,|$)");
-    message.replace(italicPattern, "\\1<i>\\2</i>\\3");
+static const char *const markupOpenTags[] = { "<i>", "<b>", "<s>", "<code>" };
+static const char *const markupCloseTags[] = { "</i>", "</b>", "</s>", "</code>" };
+
+// Equivalent to replacing (^|\s)D([^D]+)D(\s|\.|\?|!|,|$) with
+// \1<tag>\2</tag>\3 for the delimiters _ * ~ ` one after another. The tags
+// hold no whitespace, punctuation or delimiters, so the matches of one
+// delimiter do not depend on the others and all are found in one scan.
+static void replaceInlineMarkup(QString &message) {
+    struct Tag {
+        int position;
+        const char *tag;
+
+        bool operator<(const Tag &other) const {
+            return position < other.position;
+        }
+    };
+
+    const int size = message.size();
+    QVarLengthArray<Tag, 16> tags;
+    int tagsSize = 0;
+    // Matches of one delimiter do not overlap, the next may start here
+    int next[4] = { 0, 0, 0, 0 };
 
-    QRegularExpression boldPattern("(^|\\s)\\*([^\\*]+)\\*(\\s|\\.|\\?|!|,|$)");
-    message.replace(boldPattern, "\\1<b>\\2</b>\\3");
+    for (int i = 0; i < size; i++) {
+        // Markup starts at the beginning or after a space
+        int start = -1;
+        if (i == 0 && markupKind(message.at(0)) >= 0) {
+            start = 0;
+        }
+        else if (isSpace(message.at(i)) && i + 1 < size && markupKind(message.at(i + 1)) >= 0) {
+            start = i + 1;
+        }
+        if (start < 0) {
+            continue;
+        }
+
+        int kind = markupKind(message.at(start));
+        if (i < next[kind]) {
+            continue;
+        }
 
-    QRegularExpression strikePattern("(^|\\s)~([^~]+)~(\\s|\\.|\\?|!|,|$)");
-    message.replace(strikePattern, "\\1<s>\\2</s>\\3");
+        int end = message.indexOf(message.at(start), start + 1);
+        if (end <= start + 1 || (end + 1 < size && !isMarkupEnd(message.at(end + 1)))) {
+            continue;
+        }
 
-    QRegularExpression codePattern("(^|\\s)`([^`]+)`(\\s|\\.|\\?|!|,|$)");
-    message.replace(codePattern, "\\1<code>\\2</code>\\3");
+        Tag open = { start, markupOpenTags[kind] };
+        Tag close = { end, markupCloseTags[kind] };
+        tags.append(open);
+        tags.append(close);
+        tagsSize += int(strlen(open.tag) + strlen(close.tag)) - 2;
+        next[kind] = qMin(end + 2, size);
+    }
 
-    QRegularExpression codeBlockPattern("```([^`]+)```");
-    message.replace(codeBlockPattern, "<br/><code>\\1</code><br/>");
+    if (tags.isEmpty()) {
+        return;
+    }
 
-    QRegularExpression newLinePattern("\n");
-    message.replace(newLinePattern, "<br/>");
+    // Closing tags of one delimiter may come after opening tags of another
+    std::sort(tags.begin(), tags.end());
+
+    QString result;
+    result.reserve(size + tagsSize);
+    int position = 0;
+    for (int t = 0; t < tags.size(); t++) {
+        result.append(message.midRef(position, tags.at(t).position - position));
+        result.append(QLatin1String(tags.at(t).tag));
+        position = tags.at(t).position + 1;
+    }
+    result.append(message.midRef(position));
+    message.swap(result);
 }
 
-void MessageFormatter::replaceEmoji(QString &message) {
-    QRegularExpression emojiPattern(":([\\w\\+\\-]+):(:[\\w\\+\\-]+:)?[\\?\\.!,]?");
-    QRegularExpressionMatchIterator i = emojiPattern.globalMatch(message);
+static void appendWithLineBreaks(QString &result, const QString &message, int from, int to) {
+    int position = from;
+    for (int i = from; i < to; i++) {
+        if (message.at(i) == '\n') {
+            result.append(message.midRef(position, i - position));
+            result.append(QLatin1String("<br/>"));
+            position = i + 1;
+        }
+    }
+    result.append(message.midRef(position, to - position));
+}
 
-    while (i.hasNext()) {
-        QRegularExpressionMatch match = i.next();
-        QString name = match.captured(1);
+void MessageFormatter::replaceMarkdown(QString &message) {
+    replaceInlineMarkup(message);
 
-        if (MessageFormatter::emojis.contains(name)) {
-            QString image = MessageFormatter::emojis.value(name);
-            QString emoji = "<img src=\"http://emojistatic.github.io/images/32/" + image + "\" alt=\"" + name + "\" align=\"bottom\" width=\"64\" height=\"64\" />";
-            message.replace(":" + name + ":", emoji);
+    // Code blocks and line breaks in one pass. This has to follow the inline
+    // markup: a block holding `inline code` is only a block once the inline
+    // backticks are replaced.
+    const QLatin1String fence("```");
+    int start = message.indexOf(fence);
+    if (start < 0 && !message.contains('\n')) {
+        return;
+    }
+
+    QString result;
+    result.reserve(message.size() + 32);
+    int position = 0;
+
+    while (start >= 0) {
+        int end = message.indexOf('`', start + 3);
+        if (end > start + 3 && message.midRef(end, 3) == fence) {
+            appendWithLineBreaks(result, message, position, start);
+            result.append(QLatin1String("<br/><code>"));
+            appendWithLineBreaks(result, message, start + 3, end);
+            result.append(QLatin1String("</code><br/>"));
+            position = end + 3;
+            start = message.indexOf(fence, position);
         }
         else {
-          qDebug() << "Missing emoji" << name;
+            start = message.indexOf(fence, start + 1);
         }
     }
+
+    appendWithLineBreaks(result, message, position, message.size());
+    message.swap(result);
+}
+
+static const char emojiTagStart[] = "<img src=\"http://emojistatic.github.io/images/32/";
+static const char emojiTagAlt[] = "\" alt=\"";
+static const char emojiTagEnd[] = "\" align=\"bottom\" width=\"64\" height=\"64\" />";
+
+static bool isEmojiNameChar(QChar c) {
+    ushort u = c.unicode();
+    return (u >= 'a' && u <= 'z') || (u >= '0' && u <= '9') || (u >= 'A' && u <= 'Z') || u == '_' || u == '+' || u == '-';
 }
 
-void MessageFormatter::replaceTargetInfo(QString &message) {
-    QRegularExpression variableLabelPattern("<!(here|channel|group|everyone)\\|([^>]+)>");
-    message.replace(variableLabelPattern, "<a href=\"slackfish://target/\\1\">\\2</a>");
+// Returns the end of the name in a ":name" starting at `start`, or -1 if
+// there is no name followed by a colon
+static int emojiNameEnd(const QString &message, int start) {
+    int end = start + 1;
+    while (end < message.size() && isEmojiNameChar(message.at(end))) {
+        end++;
+    }
 
-    QRegularExpression variablePattern("<!(here|channel|group|everyone)>");
-    message.replace(variablePattern, "<a href=\"slackfish://target/\\1\">@\\1</a>");
+    if (end == start + 1 || end >= message.size() || message.at(end) != ':') {
+        return -1;
+    }
+    return end;
+}
+
+void MessageFormatter::replaceEmoji(QString &message) {
+    struct Hit {
+        int start;
+        int end;
+        int nameLength;
+        const char *image;
+    };
+
+    // Find all emoji first to size the result exactly
+    QVarLengthArray<Hit, 16> hits;
+    int resultSize = message.size();
+
+    int i = message.indexOf(':');
+    while (i >= 0) {
+        int end = emojiNameEnd(message, i);
+        if (end < 0) {
+            i = message.indexOf(':', i + 1);
+            continue;
+        }
+
+        QStringRef name = message.midRef(i + 1, end - i - 1);
+        const char *image = emojiImage(name);
+        if (!image) {
+            // Like an emoji, an unknown name keeps its closing colon
+            i = message.indexOf(':', end + 1);
+            continue;
+        }
+
+        Hit hit;
+        hit.start = i;
+        hit.end = end + 1;
+        hit.nameLength = name.size();
+        hit.image = image;
+
+        // Skin tone modifiers are dropped, the images have a single tone
+        int modifierEnd = hit.end < message.size() ? emojiNameEnd(message, hit.end) : -1;
+        if (modifierEnd > 0 && message.midRef(hit.end + 1, modifierEnd - hit.end - 1).startsWith(QLatin1String("skin-tone-"))) {
+            hit.end = modifierEnd + 1;
+        }
+
+        resultSize += sizeof(emojiTagStart) - 1 + strlen(image) + sizeof(emojiTagAlt) - 1 + hit.nameLength + sizeof(emojiTagEnd) - 1;
+        resultSize -= hit.end - hit.start;
+        hits.append(hit);
+
+        i = message.indexOf(':', hit.end);
+    }
+
+    if (hits.isEmpty()) {
+        return;
+    }
+
+    QString result;
+    result.reserve(resultSize);
+
+    int position = 0;
+    for (int h = 0; h < hits.size(); h++) {
+        const Hit &hit = hits.at(h);
+        result.append(message.midRef(position, hit.start - position));
+        result.append(QLatin1String(emojiTagStart));
+        result.append(QLatin1String(hit.image));
+        result.append(QLatin1String(emojiTagAlt));
+        result.append(message.midRef(hit.start + 1, hit.nameLength));
+        result.append(QLatin1String(emojiTagEnd));
+        position = hit.end;
+    }
+    result.append(message.midRef(position));
+
+    message.swap(result);
 }
 
 void MessageFormatter::replaceSpecialCharacters(QString &message) {
-    message.replace(QRegularExpression("&gt;"), ">");
-    message.replace(QRegularExpression("&lt;"), "<");
-    message.replace(QRegularExpression("&amp;"), "&");
+    int i = message.indexOf('&');
+    if (i < 0) {
+        return;
+    }
+
+    QString result;
+    result.reserve(message.size());
+    int position = 0;
+
+    while (i >= 0) {
+        QStringRef rest = message.midRef(i);
+        QChar character;
+        int length = 0;
+
+        if (rest.startsWith(QLatin1String("&gt;"))) {
+            character = '>';
+            length = 4;
+        }
+        else if (rest.startsWith(QLatin1String("&lt;"))) {
+            character = '<';
+            length = 4;
+        }
+        else if (rest.startsWith(QLatin1String("&amp;"))) {
+            character = '&';
+            length = 5;
+        }
+
+        if (length > 0) {
+            result.append(message.midRef(position, i - position));
+            result.append(character);
+            position = i + length;
+            i = message.indexOf('&', position);
+        }
+        else {
+            i = message.indexOf('&', i + 1);
+        }
+    }
+
+    result.append(message.midRef(position));
+    message.swap(result);
 }
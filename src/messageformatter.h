@@ -2,20 +2,30 @@
 #define MESSAGEFORMATTER_H
 
 #include <QObject>
+#include <QStringList>
 
 class MessageFormatter : public QObject
 {
     Q_OBJECT
 public:
-    static void replaceUserInfo(QString &message);
-    static void replaceTargetInfo(QString &message);
-    static void replaceChannelInfo(QString &message);
+    enum TokenType {
+        UserToken = 0x1,
+        ChannelToken = 0x2,
+        TargetToken = 0x4,
+        LinkToken = 0x8,
+        AllTokens = UserToken | ChannelToken | TargetToken | LinkToken
+    };
+
+    static void replaceTokens(QString &message, int types = AllTokens, QStringList *references = 0);
     static void replaceSpecialCharacters(QString &message);
     static void replaceLinks(QString &message);
     static void replaceMarkdown(QString &message);
     static void replaceEmoji(QString &message);
 
-    static QMap<QString,QString> emojis;
+    static const char *emojiImage(const QStringRef &name);
+
+private:
+    static bool formatToken(const QString &token, int types, QString &result, QStringList *references);
 
 signals:
 
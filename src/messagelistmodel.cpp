@@ -0,0 +1,184 @@
+#include "messagelistmodel.h"
+
+static const int formatBatchSize = 4;
+
+MessageListModel::MessageListModel(const QString &channelId, QObject *parent) : QAbstractListModel(parent), id(channelId) {
+    idleTimer = new QTimer(this);
+    idleTimer->setSingleShot(true);
+    idleTimer->setInterval(0);
+    connect(idleTimer, SIGNAL(timeout()), this, SLOT(formatPending()));
+}
+
+void MessageListModel::setFormatter(Formatter formatter) {
+    this->formatter = formatter;
+}
+
+QString MessageListModel::channelId() const {
+    return id;
+}
+
+QHash<int, QByteArray> MessageListModel::roleNames() const {
+    QHash<int, QByteArray> roles = QAbstractListModel::roleNames();
+    roles.insert(TypeRole, QByteArray("type"));
+    roles.insert(TimeRole, QByteArray("time"));
+    roles.insert(TimegroupRole, QByteArray("timegroup"));
+    roles.insert(TimestampRole, QByteArray("timestamp"));
+    roles.insert(ChannelRole, QByteArray("channel"));
+    roles.insert(UserRole, QByteArray("user"));
+    roles.insert(ContentRole, QByteArray("content"));
+    roles.insert(AttachmentsRole, QByteArray("attachments"));
+    roles.insert(ImagesRole, QByteArray("images"));
+    return roles;
+}
+
+int MessageListModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid()) {
+        return 0;
+    }
+
+    return messages.size();
+}
+
+QVariant MessageListModel::data(const QModelIndex &index, int role) const {
+    if (index.row() < 0 || index.row() >= messages.size()) {
+        return QVariant();
+    }
+
+    if (role == ContentRole || role == AttachmentsRole || role == ImagesRole) {
+        ensureFormatted(index.row());
+    }
+
+    const Message &message = messages.at(index.row());
+    switch (role) {
+    case TypeRole:
+        return message.type;
+    case TimeRole:
+        return message.time;
+    case TimegroupRole:
+        return message.timegroup;
+    case TimestampRole:
+        return message.timestamp;
+    case ChannelRole:
+        return message.channel;
+    case UserRole:
+        return message.user.toMap();
+    case ContentRole:
+        return message.content;
+    case AttachmentsRole:
+        return message.attachments;
+    case ImagesRole:
+        return message.images;
+    default:
+        return QVariant();
+    }
+}
+
+QVariantMap MessageListModel::get(int row) const {
+    if (row < 0 || row >= messages.size()) {
+        return QVariantMap();
+    }
+
+    ensureFormatted(row);
+    return messages.at(row).toMap();
+}
+
+void MessageListModel::prefetch(int firstVisible, int lastVisible, int direction) {
+    // Format about one screen of messages ahead in the scroll direction
+    int screen = qMax(1, lastVisible - firstVisible + 1);
+    int from = direction < 0 ? firstVisible - 1 : lastVisible + 1;
+    int step = direction < 0 ? -1 : 1;
+
+    pendingRows.clear();
+    for (int i = 0, row = from; i < screen && row >= 0 && row < messages.size(); i++, row += step) {
+        if (!messages.at(row).isFormatted()) {
+            pendingRows.append(row);
+        }
+    }
+
+    if (!pendingRows.isEmpty() && !idleTimer->isActive()) {
+        idleTimer->start();
+    }
+}
+
+void MessageListModel::formatPending() {
+    for (int i = 0; i < formatBatchSize && !pendingRows.isEmpty(); i++) {
+        int row = pendingRows.takeFirst();
+        if (row >= 0 && row < messages.size()) {
+            ensureFormatted(row);
+        }
+    }
+
+    if (!pendingRows.isEmpty()) {
+        idleTimer->start();
+    }
+}
+
+// The formatted message replaces the stored one too, so that a later
+// setMessages() from Storage does not format it again
+void MessageListModel::ensureFormatted(int row) const {
+    if (formatter && !messages.at(row).isFormatted()) {
+        formatter(messages[row]);
+        Storage::updateChannelMessage(id, messages.at(row));
+    }
+}
+
+void MessageListModel::setMessages(const QList<Message> &list) {
+    beginResetModel();
+    messages = list.mid(qMax(0, list.size() - Storage::channelMessageLimit()));
+    pendingRows.clear();
+    endResetModel();
+    emit countChanged();
+}
+
+void MessageListModel::prependMessages(const QList<Message> &list) {
+    // Same as the Storage buffer: messages already shown are skipped and
+    // older history is not kept once full
+    int older = messages.isEmpty() ? list.size() : countBefore(list, messages.first());
+    int count = qMin(older, Storage::channelMessageLimit() - messages.size());
+    if (count <= 0) {
+        return;
+    }
+
+    beginInsertRows(QModelIndex(), 0, count - 1);
+    messages = list.mid(older - count, count) + messages;
+    for (int i = 0; i < pendingRows.size(); i++) {
+        pendingRows[i] += count;
+    }
+    endInsertRows();
+    emit countChanged();
+}
+
+bool MessageListModel::isFull() const {
+    return messages.size() >= Storage::channelMessageLimit();
+}
+
+// Like the Storage buffer, the oldest rows are dropped to make room, even
+// if the view is scrolled up to them; the model and buffer stay the same.
+void MessageListModel::appendMessage(const Message &message) {
+    int overflow = messages.size() + 1 - Storage::channelMessageLimit();
+    if (overflow > 0) {
+        beginRemoveRows(QModelIndex(), 0, overflow - 1);
+        messages.erase(messages.begin(), messages.begin() + overflow);
+        for (int i = 0; i < pendingRows.size(); i++) {
+            pendingRows[i] -= overflow;
+        }
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), messages.size(), messages.size());
+    messages.append(message);
+    endInsertRows();
+    emit countChanged();
+}
+
+void MessageListModel::clear() {
+    if (messages.isEmpty()) {
+        return;
+    }
+
+    beginResetModel();
+    messages.clear();
+    pendingRows.clear();
+    endResetModel();
+    emit countChanged();
+}
@@ -0,0 +1,83 @@
+#ifndef MESSAGELISTMODEL_H
+#define MESSAGELISTMODEL_H
+
+#include <functional>
+
+#include <QAbstractListModel>
+#include <QPointer>
+#include <QList>
+#include <QTimer>
+#include <QVariantMap>
+
+#include "storage.h"
+
+// Messages of one channel in time order, mirroring the channel's buffer in
+// Storage and sharing its message data. Like the buffer it holds at most
+// Storage::channelMessageLimit() messages. Role values are built only when
+// a delegate asks for them, and history messages are formatted the first
+// time their content is asked for or when prefetch() reaches them. The
+// formatted message is written back to the buffer.
+class MessageListModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(QString channelId READ channelId CONSTANT)
+    Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+
+public:
+    enum MessageRoles {
+        TypeRole = Qt::UserRole + 1,
+        TimeRole,
+        TimegroupRole,
+        TimestampRole,
+        ChannelRole,
+        UserRole,
+        ContentRole,
+        AttachmentsRole,
+        ImagesRole
+    };
+
+    typedef std::function<void(Message&)> Formatter;
+
+    explicit MessageListModel(const QString &channelId, QObject *parent = 0);
+
+    void setFormatter(Formatter formatter);
+
+    QString channelId() const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+    Q_INVOKABLE QVariantMap get(int row) const;
+    Q_INVOKABLE void prefetch(int firstVisible, int lastVisible, int direction);
+
+    // True once the model holds Storage::channelMessageLimit() messages,
+    // after which no older history is kept
+    bool isFull() const;
+
+    void setMessages(const QList<Message> &messages);
+    void prependMessages(const QList<Message> &messages);
+    void appendMessage(const Message &message);
+    void clear();
+
+signals:
+    void countChanged();
+
+private slots:
+    void formatPending();
+
+protected:
+    QHash<int, QByteArray> roleNames() const;
+
+private:
+    void ensureFormatted(int row) const;
+
+    QString id;
+    Formatter formatter;
+    QPointer<QTimer> idleTimer;
+    QList<int> pendingRows;
+
+    // Formatting on first access fills in the stored messages
+    mutable QList<Message> messages;
+};
+
+#endif // MESSAGELISTMODEL_H
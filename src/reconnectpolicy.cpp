@@ -0,0 +1,92 @@
+#include "reconnectpolicy.h"
+
+#include <QDebug>
+#include <QDateTime>
+
+ReconnectPolicy::ReconnectPolicy(QObject *parent) :
+    QObject(parent), attemptCount(0), delay(0), nextAttempt(0), pending(false), networkAvailable(true) {
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    connect(timer, SIGNAL(timeout()), this, SLOT(handleTimeout()));
+
+    qsrand(uint(QDateTime::currentMSecsSinceEpoch()));
+}
+
+int ReconnectPolicy::attempts() const {
+    return attemptCount;
+}
+
+int ReconnectPolicy::lastDelay() const {
+    return delay;
+}
+
+qint64 ReconnectPolicy::nextAttemptAt() const {
+    return timer->isActive() ? nextAttempt : 0;
+}
+
+bool ReconnectPolicy::isPending() const {
+    return pending;
+}
+
+bool ReconnectPolicy::isSuspended() const {
+    return pending && !networkAvailable;
+}
+
+void ReconnectPolicy::schedule() {
+    pending = true;
+
+    if (networkAvailable) {
+        startTimer();
+    }
+    else {
+        qDebug() << "Reconnect suspended until network is available";
+    }
+}
+
+void ReconnectPolicy::cancel() {
+    pending = false;
+    timer->stop();
+}
+
+void ReconnectPolicy::reset() {
+    cancel();
+    attemptCount = 0;
+}
+
+void ReconnectPolicy::setNetworkAvailable(bool available) {
+    if (available == networkAvailable) {
+        return;
+    }
+
+    networkAvailable = available;
+
+    if (!pending) {
+        return;
+    }
+
+    if (networkAvailable) {
+        // Failures while offline say nothing about the server, start over
+        attemptCount = 0;
+        startTimer();
+    }
+    else {
+        timer->stop();
+        qDebug() << "Reconnect suspended until network is available";
+    }
+}
+
+void ReconnectPolicy::startTimer() {
+    int limit = baseDelay << qMin(attemptCount, 7);
+    limit = qMin(limit, maxDelay);
+    delay = limit / 2 + qrand() % (limit / 2 + 1);
+
+    nextAttempt = QDateTime::currentMSecsSinceEpoch() + delay;
+    timer->start(delay);
+    qDebug() << "Reconnect attempt" << attemptCount + 1 << "in" << delay << "ms";
+}
+
+void ReconnectPolicy::handleTimeout() {
+    pending = false;
+    attemptCount++;
+    emit reconnect();
+}
@@ -0,0 +1,50 @@
+#ifndef RECONNECTPOLICY_H
+#define RECONNECTPOLICY_H
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+
+// Decides when to reconnect after the connection was lost or a connect
+// attempt failed. Delays double with each failed attempt up to a cap, and
+// each is picked at random from its upper half so that clients dropped
+// together do not reconnect together. While the network is down nothing
+// is attempted; a pending reconnect runs shortly after it comes back.
+class ReconnectPolicy : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ReconnectPolicy(QObject *parent = 0);
+
+    int attempts() const;
+    int lastDelay() const;
+    qint64 nextAttemptAt() const;
+    bool isPending() const;
+    bool isSuspended() const;
+
+    void schedule();
+    void cancel();
+    void reset();
+    void setNetworkAvailable(bool available);
+
+signals:
+    void reconnect();
+
+private slots:
+    void handleTimeout();
+
+private:
+    void startTimer();
+
+    QPointer<QTimer> timer;
+    int attemptCount;
+    int delay;
+    qint64 nextAttempt;
+    bool pending;
+    bool networkAvailable;
+
+    static const int baseDelay = 1000;
+    static const int maxDelay = 120000;
+};
+
+#endif // RECONNECTPOLICY_H
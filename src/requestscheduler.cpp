@@ -0,0 +1,163 @@
+#include "requestscheduler.h"
+
+#include <QDebug>
+#include <QDateTime>
+
+RequestScheduler::RequestScheduler(QNetworkAccessManager *networkAccessManager, QObject *parent) :
+    QObject(parent), networkAccessManager(networkAccessManager), maxConcurrent(4), active(0), nextId(1) {
+    dispatchTimer = new QTimer(this);
+    dispatchTimer->setSingleShot(true);
+    connect(dispatchTimer, SIGNAL(timeout()), this, SLOT(dispatch()));
+}
+
+int RequestScheduler::get(const QString &method, const QNetworkRequest &request, Priority priority, Handler handler) {
+    Request item;
+    item.id = nextId++;
+    item.method = method;
+    item.request = request;
+    item.priority = priority;
+    item.handler = handler;
+    item.attempts = 0;
+
+    queues[priority].append(item);
+    dispatch();
+    return item.id;
+}
+
+bool RequestScheduler::cancel(int id) {
+    for (int i = Interactive; i <= Background; i++) {
+        QList<Request> &queue = queues[i];
+
+        for (int j = 0; j < queue.size(); j++) {
+            if (queue.at(j).id == id) {
+                queue.removeAt(j);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void RequestScheduler::setMaxConcurrentRequests(int max) {
+    maxConcurrent = qMax(1, max);
+    dispatch();
+}
+
+void RequestScheduler::clear() {
+    for (int i = Interactive; i <= Background; i++) {
+        queues[i].clear();
+    }
+    dispatchTimer->stop();
+}
+
+RequestScheduler::Tier RequestScheduler::methodTier(const QString &method) {
+    if (method == "rtm.connect") {
+        return Tier1;
+    }
+    else if (method == "users.list" || method == "conversations.list") {
+        return Tier2;
+    }
+    else if (method.endsWith(".info") || method.endsWith(".history") || method.endsWith(".mark")) {
+        return Tier3;
+    }
+    else {
+        return Tier4;
+    }
+}
+
+int RequestScheduler::tierLimit(Tier tier) {
+    switch (tier) {
+    case Tier1:
+        return 1;
+    case Tier2:
+        return 20;
+    case Tier3:
+        return 50;
+    default:
+        return 100;
+    }
+}
+
+qint64 RequestScheduler::availableAt(const QString &method, qint64 now) {
+    MethodState &state = methods[method];
+
+    while (!state.sent.isEmpty() && state.sent.head() <= now - 60000) {
+        state.sent.dequeue();
+    }
+
+    if (state.blockedUntil > now) {
+        return state.blockedUntil;
+    }
+    else if (state.sent.size() < tierLimit(methodTier(method))) {
+        return now;
+    }
+    else {
+        return state.sent.head() + 60000;
+    }
+}
+
+void RequestScheduler::dispatch() {
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 next = 0;
+
+    for (int priority = Interactive; priority <= Background && active < maxConcurrent; priority++) {
+        QList<Request> &queue = queues[priority];
+
+        int i = 0;
+        while (i < queue.size() && active < maxConcurrent) {
+            qint64 time = availableAt(queue.at(i).method, now);
+
+            if (time <= now) {
+                send(queue.takeAt(i), now);
+            }
+            else {
+                next = next == 0 ? time : qMin(next, time);
+                i++;
+            }
+        }
+    }
+
+    if (next > 0 && active < maxConcurrent) {
+        dispatchTimer->start(qMax<qint64>(next - now, 10));
+    }
+}
+
+void RequestScheduler::send(const Request &request, qint64 now) {
+    if (networkAccessManager.isNull()) {
+        return;
+    }
+
+    methods[request.method].sent.enqueue(now);
+    active++;
+
+    qDebug() << "GET" << request.request.url().toString();
+    QNetworkReply *reply = networkAccessManager->get(request.request);
+    connect(reply, &QNetworkReply::finished, [request,reply,this]() {
+        handleFinished(request, reply);
+    });
+}
+
+void RequestScheduler::handleFinished(Request request, QNetworkReply *reply) {
+    active--;
+
+    int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (statusCode == 429 && request.attempts + 1 < maxAttempts) {
+        bool ok;
+        int seconds = reply->rawHeader("Retry-After").toInt(&ok);
+        if (!ok || seconds <= 0) {
+            seconds = 1;
+        }
+
+        qDebug() << "Rate limited" << request.method << "retry after" << seconds;
+        methods[request.method].blockedUntil = QDateTime::currentMSecsSinceEpoch() + seconds * 1000;
+
+        request.attempts++;
+        queues[request.priority].prepend(request);
+    }
+    else {
+        request.handler(reply);
+    }
+
+    reply->deleteLater();
+    dispatch();
+}
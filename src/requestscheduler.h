@@ -0,0 +1,88 @@
+#ifndef REQUESTSCHEDULER_H
+#define REQUESTSCHEDULER_H
+
+#include <functional>
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QList>
+#include <QQueue>
+#include <QHash>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkRequest>
+#include <QtNetwork/QNetworkReply>
+
+// Queues Web API GET requests and sends them with a limited number in
+// flight, highest priority first, within Slack's per-method rate limit
+// tiers. Requests answered with HTTP 429 are sent again after the
+// Retry-After delay. The handler receives the finished reply, which the
+// scheduler deletes afterwards. A request can be cancelled by the id
+// get() returns until it has been sent.
+class RequestScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    enum Priority {
+        Interactive,
+        Normal,
+        Background
+    };
+
+    enum Tier {
+        Tier1,
+        Tier2,
+        Tier3,
+        Tier4
+    };
+
+    typedef std::function<void(QNetworkReply*)> Handler;
+
+    explicit RequestScheduler(QNetworkAccessManager *networkAccessManager, QObject *parent = 0);
+
+    int get(const QString &method, const QNetworkRequest &request, Priority priority, Handler handler);
+    bool cancel(int id);
+    void setMaxConcurrentRequests(int max);
+    void clear();
+
+    static Tier methodTier(const QString &method);
+    static int tierLimit(Tier tier);
+
+private slots:
+    void dispatch();
+
+private:
+    struct Request {
+        int id;
+        QString method;
+        QNetworkRequest request;
+        Priority priority;
+        Handler handler;
+        int attempts;
+    };
+
+    // Slack applies a tier's limit to each method separately
+    struct MethodState {
+        MethodState() : blockedUntil(0) {}
+
+        QQueue<qint64> sent;
+        qint64 blockedUntil;
+    };
+
+    qint64 availableAt(const QString &method, qint64 now);
+    void send(const Request &request, qint64 now);
+    void handleFinished(Request request, QNetworkReply *reply);
+
+    QPointer<QNetworkAccessManager> networkAccessManager;
+    QPointer<QTimer> dispatchTimer;
+
+    QList<Request> queues[Background + 1];
+    QHash<QString,MethodState> methods;
+    int maxConcurrent;
+    int active;
+    int nextId;
+
+    static const int maxAttempts = 3;
+};
+
+#endif // REQUESTSCHEDULER_H
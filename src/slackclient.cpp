@@ -2,6 +2,7 @@
 #include <QUrlQuery>
 #include <QDebug>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
@@ -12,10 +13,9 @@
 #include <QFile>
 #include <QHttpMultiPart>
 #include <QtNetwork/QNetworkConfigurationManager>
+#include <QQmlEngine>
 #include <nemonotifications-qt5/notification.h>
 
-#include "asyncfuture.h"
-
 #include "slackclient.h"
 #include "storage.h"
 #include "messageformatter.h"
@@ -24,15 +24,73 @@ SlackClient::SlackClient(QObject *parent) : QObject(parent), appActive(true), ac
     networkAccessManager = new QNetworkAccessManager(this);
     config = new SlackConfig(this);
     stream = new SlackStream(this);
-    reconnectTimer = new QTimer(this);
+    reconnectPolicy = new ReconnectPolicy(this);
+    updateTimer = new QTimer(this);
+    snapshotTimer = new QTimer(this);
+    scheduler = new RequestScheduler(networkAccessManager, this);
+    pipeline = new WorkerPipeline(this);
+    channelListModel = new ChannelListModel(this);
     networkAccessible = networkAccessManager->networkAccessible();
+    reconnectPolicy->setNetworkAvailable(networkAccessible == QNetworkAccessManager::Accessible);
+
+    Storage::setChannelMessageLimit(config->channelMessageLimit());
+    stream->setMessageSizeLimit(config->streamMessageSizeLimit());
 
     connect(networkAccessManager, SIGNAL(networkAccessibleChanged(QNetworkAccessManager::NetworkAccessibility)), this, SLOT(handleNetworkAccessibleChanged(QNetworkAccessManager::NetworkAccessibility)));
-    connect(reconnectTimer, SIGNAL(timeout()), this, SLOT(reconnect()));
+    connect(reconnectPolicy, SIGNAL(reconnect()), this, SLOT(handleScheduledReconnect()));
+
+    updateTimer->setSingleShot(true);
+    updateTimer->setInterval(0);
+    connect(updateTimer, SIGNAL(timeout()), this, SLOT(emitPendingUpdates()));
+
+    snapshotTimer->setSingleShot(true);
+    snapshotTimer->setInterval(snapshotDelay);
+    connect(snapshotTimer, SIGNAL(timeout()), this, SLOT(saveSnapshot()));
 
     connect(stream, SIGNAL(connected()), this, SLOT(handleStreamStart()));
     connect(stream, SIGNAL(disconnected()), this, SLOT(handleStreamEnd()));
     connect(stream, SIGNAL(messageReceived(QJsonObject)), this, SLOT(handleStreamMessage(QJsonObject)));
+
+    connect(this, SIGNAL(initSuccess()), channelListModel, SLOT(reload()));
+    connect(this, SIGNAL(snapshotRestored()), channelListModel, SLOT(reload()));
+    connect(this, SIGNAL(channelsUpdated(QStringList)), channelListModel, SLOT(updateChannels(QStringList)));
+
+    registerEventHandler("message", &SlackClient::parseMessageUpdate);
+    registerEventHandler("channel_marked", &SlackClient::parseChannelUpdate);
+    registerEventHandler("group_marked", &SlackClient::parseChannelUpdate);
+    registerEventHandler("im_marked", &SlackClient::parseChannelUpdate);
+    registerEventHandler("mpim_marked", &SlackClient::parseChannelUpdate);
+    registerEventHandler("channel_joined", &SlackClient::parseChannelJoin);
+    registerEventHandler("group_joined", &SlackClient::parseGroupJoin);
+    registerEventHandler("im_open", &SlackClient::parseChatOpen);
+    registerEventHandler("im_close", &SlackClient::parseChatClose);
+    registerEventHandler("channel_left", &SlackClient::parseChannelLeft);
+    registerEventHandler("group_left", &SlackClient::parseChannelLeft);
+    registerEventHandler("presence_change", &SlackClient::parsePresenceChange);
+    registerEventHandler("desktop_notification", &SlackClient::parseNotification);
+}
+
+void SlackClient::registerEventHandler(const QString &type, EventHandler handler) {
+    eventHandlers.insert(type, handler);
+}
+
+ChannelListModel *SlackClient::getChannelListModel() const {
+    return channelListModel;
+}
+
+MessageListModel *SlackClient::messageListModel(QString channelId) {
+    QPointer<MessageListModel> model = messageListModels.value(channelId);
+
+    if (model.isNull()) {
+        model = new MessageListModel(channelId, this);
+        model->setFormatter([this](Message &message) {
+            formatMessage(message);
+        });
+        QQmlEngine::setObjectOwnership(model, QQmlEngine::CppOwnership);
+        messageListModels.insert(channelId, model);
+    }
+
+    return model;
 }
 
 QString SlackClient::toString(const QJsonObject &data) {
@@ -64,6 +122,7 @@ void SlackClient::clearNotifications() {
 void SlackClient::handleNetworkAccessibleChanged(QNetworkAccessManager::NetworkAccessibility accessible) {
     qDebug() << "Network accessible changed" << accessible;
     networkAccessible = accessible;
+    reconnectPolicy->setNetworkAvailable(networkAccessible == QNetworkAccessManager::Accessible);
 
     if (networkAccessible == QNetworkAccessManager::Accessible) {
         emit networkOn();
@@ -75,19 +134,42 @@ void SlackClient::handleNetworkAccessibleChanged(QNetworkAccessManager::NetworkA
 
 void SlackClient::reconnect() {
     qDebug() << "Reconnecting";
+    // A reconnect asked for directly replaces a scheduled one, and its
+    // failure is reported instead of retried
+    reconnectPolicy->reset();
+    emit reconnecting();
+    start();
+}
+
+// Only copying the data happens here, serializing and writing it runs on
+// a worker; the snapshot is also saved on exit
+void SlackClient::saveSnapshot() {
+    Snapshot snapshot = Storage::takeSnapshot();
+
+    pipeline->run<bool>("snapshot", [snapshot]() {
+        return Storage::writeSnapshot(snapshot);
+    }, [](const bool &saved) {
+        if (!saved) {
+            qDebug() << "Snapshot not saved";
+        }
+    });
+}
+
+void SlackClient::handleScheduledReconnect() {
+    qDebug() << "Reconnecting attempt" << reconnectPolicy->attempts();
     emit reconnecting();
     start();
 }
 
 void SlackClient::handleStreamStart() {
     qDebug() << "Stream started";
+    reconnectPolicy->reset();
     emit connected();
 
     QJsonArray userIds;
-    foreach (const QVariant &value, Storage::users()) {
-        QVariantMap user = value.toMap();
-        if (user.value("name") != QVariant("slackbot")) {
-            userIds.append(QJsonValue::fromVariant(user.value("id")));
+    foreach (const User &user, Storage::users()) {
+        if (user.name != "slackbot") {
+            userIds.append(QJsonValue(user.id));
         }
     }
 
@@ -103,144 +185,203 @@ void SlackClient::handleStreamEnd() {
     if (!config->accessToken().isEmpty()) {
         qDebug() << "Stream reconnect scheduled";
         emit reconnecting();
-        reconnectTimer->setSingleShot(true);
-        reconnectTimer->start(1000);
+        reconnectPolicy->schedule();
     }
 }
 
+SlackClient::~SlackClient() {
+    // Worker functions use this client
+    pipeline->waitForDone();
+}
+
 void SlackClient::handleStreamMessage(QJsonObject message) {
     QString type = message.value("type").toString();
+    eventStats[type].count++;
 
-    if (type == "message") {
-        parseMessageUpdate(message);
-    }
-    else if (type == "group_marked" || type == "channel_marked" || type == "im_marked" || type == "mpim_marked") {
-        parseChannelUpdate(message);
-    }
-    else if (type == "channel_joined") {
-        parseChannelJoin(message);
-    }
-    else if (type == "group_joined") {
-        parseGroupJoin(message);
-    }
-    else if (type == "im_open") {
-        parseChatOpen(message);
-    }
-    else if (type == "im_close") {
-        parseChatClose(message);
-    }
-    else if (type == "channel_left" || type == "group_left") {
-        parseChannelLeft(message);
+    EventHandler handler = eventHandlers.value(type);
+    if (!handler) {
+        return;
     }
-    else if (type == "presence_change") {
-        parsePresenceChange(message);
+
+    std::function<void()> handle = [handler,message,type,this]() {
+        QElapsedTimer timer;
+        timer.start();
+        (this->*handler)(message);
+        eventStats[type].nsecs += timer.nsecsElapsed();
+    };
+
+    // Message events are parsed on the pipeline keyed by channel, so other
+    // events of the same channel wait for them to keep their order
+    QJsonValue channel = message.value("channel");
+    QString channelId = channel.isObject() ? channel.toObject().value("id").toString() : channel.toString();
+
+    if (type != "message" && !channelId.isEmpty()) {
+        pipeline->post(channelId, handle);
     }
-    else if (type == "desktop_notification") {
-        parseNotification(message);
+    else {
+        handle();
     }
 }
 
 void SlackClient::parseChatOpen(QJsonObject message) {
     QString id = message.value("channel").toString();
-    QVariantMap channel = Storage::channel(id);
-    channel.insert("isOpen", QVariant(true));
+    Channel channel = Storage::channel(id);
+    if (!channel.isValid()) {
+        return;
+    }
+
+    channel.isOpen = true;
     Storage::saveChannel(channel);
-    emit channelJoined(channel);
+    queueChannelUpdate(channel.id);
+    emit channelJoined(channel.toMap());
 }
 
 void SlackClient::parseChatClose(QJsonObject message) {
     QString id = message.value("channel").toString();
-    QVariantMap channel = Storage::channel(id);
-    channel.insert("isOpen", QVariant(false));
+    Channel channel = Storage::channel(id);
+    if (!channel.isValid()) {
+        return;
+    }
+
+    channel.isOpen = false;
     Storage::saveChannel(channel);
-    emit channelLeft(channel);
+    queueChannelUpdate(channel.id);
+    emit channelLeft(channel.toMap());
 }
 
 void SlackClient::parseChannelJoin(QJsonObject message) {
-    QVariantMap data = parseChannel(message.value("channel").toObject());
+    Channel data = parseChannel(message.value("channel").toObject());
+    if (!data.isValid()) {
+        return;
+    }
+
     Storage::saveChannel(data);
-    emit channelJoined(data);
+    queueChannelUpdate(data.id);
+    emit channelJoined(data.toMap());
 }
 
 void SlackClient::parseChannelLeft(QJsonObject message) {
     QString id = message.value("channel").toString();
-    QVariantMap channel = Storage::channel(id);
-    channel.insert("isOpen", QVariant(false));
+    Channel channel = Storage::channel(id);
+    if (!channel.isValid()) {
+        return;
+    }
+
+    channel.isOpen = false;
     Storage::saveChannel(channel);
-    emit channelLeft(channel);
+    queueChannelUpdate(channel.id);
+    emit channelLeft(channel.toMap());
 }
 
 void SlackClient::parseGroupJoin(QJsonObject message) {
-    QVariantMap data = parseGroup(message.value("channel").toObject());
+    Channel data = parseGroup(message.value("channel").toObject());
+    if (!data.isValid()) {
+        return;
+    }
+
     Storage::saveChannel(data);
-    emit channelJoined(data);
+    queueChannelUpdate(data.id);
+    emit channelJoined(data.toMap());
 }
 
 void SlackClient::parseChannelUpdate(QJsonObject message) {
     QString id = message.value("channel").toString();
-    QVariantMap channel = Storage::channel(id);
-    channel.insert("lastRead", message.value("ts").toVariant());
-    channel.insert("unreadCount", message.value("unread_count_display").toVariant());
+    Channel channel = Storage::channel(id);
+    if (!channel.isValid()) {
+        return;
+    }
+
+    channel.lastRead = message.value("ts").toString();
+    channel.unreadCount = message.value("unread_count_display").toInt();
     Storage::saveChannel(channel);
-    emit channelUpdated(channel);
+    queueChannelUpdate(channel.id);
 }
 
 void SlackClient::parseMessageUpdate(QJsonObject message) {
-    QVariantMap data = getMessageData(message);
-
     QString channelId = message.value("channel").toString();
-    if (Storage::channelMessagesExist(channelId)) {
-        Storage::appendChannelMessage(channelId, data);
-    }
 
-    QVariantMap channel = Storage::channel(channelId);
+    pipeline->run<Message>(channelId, [message,this]() {
+        return getMessageData(message);
+    }, [channelId,this](const Message &data) {
+        if (Storage::channelMessagesExist(channelId)) {
+            Storage::appendChannelMessage(channelId, data);
 
-    QString messageTime = data.value("timestamp").toString();
-    QString latestRead = channel.value("lastRead").toString();
+            MessageListModel *model = messageListModels.value(channelId);
+            if (model) {
+                model->appendMessage(data);
+            }
+        }
 
-    if (messageTime > latestRead) {
-        int unreadCount = channel.value("unreadCount").toInt() + 1;
-        channel.insert("unreadCount", unreadCount);
-        Storage::saveChannel(channel);
-        emit channelUpdated(channel);
-    }
+        Channel channel = Storage::channel(channelId);
+        if (!channel.isValid()) {
+            return;
+        }
+
+        if (data.timestamp > channel.lastRead) {
+            channel.unreadCount += 1;
+            Storage::saveChannel(channel);
+            queueChannelUpdate(channel.id);
+        }
 
-    if (channel.value("isOpen").toBool() == false) {
-        if (channel.value("type").toString() == "im") {
-            openChat(channelId);
+        if (!channel.isOpen) {
+            if (channel.type == "im") {
+                openChat(channelId);
+            }
         }
-    }
 
-    emit messageReceived(data);
+        emit messageReceived(data.toMap());
+    });
 }
 
 void SlackClient::parsePresenceChange(QJsonObject message) {
-    QVariant presence = message.value("presence").toVariant();
-    QVariantList userIds;
+    QString presence = message.value("presence").toString();
+    QStringList userIds;
     if (message.contains("user")) {
-        userIds << message.value("user").toVariant();
+        userIds << message.value("user").toString();
     }
     else {
-        userIds = message.value("users").toArray().toVariantList();
+        foreach (const QJsonValue &value, message.value("users").toArray()) {
+            userIds << value.toString();
+        }
     }
 
-    foreach (QVariant userId, userIds) {
-        QVariantMap user = Storage::user(userId);
-        if (!user.isEmpty()) {
-            user.insert("presence", presence);
-            Storage::saveUser(user);
-            emit userUpdated(user);
-        }
+    QStringList changedUserIds;
+    QStringList changedChannelIds;
+    Storage::savePresence(userIds, presence, changedUserIds, changedChannelIds);
 
-        foreach (QVariant item, Storage::channels()) {
-            QVariantMap channel = item.toMap();
+    foreach (const QString &userId, changedUserIds) {
+        queueUserUpdate(userId);
+    }
+    foreach (const QString &channelId, changedChannelIds) {
+        queueChannelUpdate(channelId);
+    }
+}
 
-            if (channel.value("type") == QVariant("im") && channel.value("userId") == userId) {
-                channel.insert("presence", presence);
-                Storage::saveChannel(channel);
-                emit channelUpdated(channel);
-            }
-        }
+void SlackClient::queueChannelUpdate(const QString &channelId) {
+    pendingChannelIds.insert(channelId);
+    if (!updateTimer->isActive()) {
+        updateTimer->start();
+    }
+}
+
+void SlackClient::queueUserUpdate(const QString &userId) {
+    pendingUserIds.insert(userId);
+    if (!updateTimer->isActive()) {
+        updateTimer->start();
+    }
+}
+
+void SlackClient::emitPendingUpdates() {
+    if (!pendingUserIds.isEmpty()) {
+        QStringList userIds = pendingUserIds.toList();
+        pendingUserIds.clear();
+        emit usersUpdated(userIds);
+    }
+
+    if (!pendingChannelIds.isEmpty()) {
+        QStringList channelIds = pendingChannelIds.toList();
+        pendingChannelIds.clear();
+        emit channelsUpdated(channelIds);
     }
 }
 
@@ -290,22 +431,26 @@ bool SlackClient::isError(const QJsonObject &data) {
 
 QJsonObject SlackClient::getResult(QNetworkReply *reply) {
     if (isOk(reply)) {
-        QJsonParseError error;
-        QJsonDocument document = QJsonDocument::fromJson(reply->readAll(), &error);
+        return parseJson(reply->readAll());
+    }
+    else {
+        return QJsonObject();
+    }
+}
 
-        if (error.error == QJsonParseError::NoError) {
-            return document.object();
-        }
-        else {
-            return QJsonObject();
-        }
+QJsonObject SlackClient::parseJson(const QByteArray &body) {
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(body, &error);
+
+    if (error.error == QJsonParseError::NoError) {
+        return document.object();
     }
     else {
         return QJsonObject();
     }
 }
 
-QNetworkReply* SlackClient::executeGet(QString method, QMap<QString, QString> params) {
+QNetworkRequest SlackClient::getRequest(QString method, const QMap<QString, QString> &params) {
     QUrlQuery query;
 
     QString token = config->accessToken();
@@ -319,12 +464,51 @@ QNetworkReply* SlackClient::executeGet(QString method, QMap<QString, QString> pa
 
     QUrl url("https://slack.com/api/" + method);
     url.setQuery(query);
-    QNetworkRequest request(url);
+    return QNetworkRequest(url);
+}
+
+QNetworkReply* SlackClient::executeGet(QString method, QMap<QString, QString> params) {
+    QNetworkRequest request = getRequest(method, params);
 
-    qDebug() << "GET" << url.toString();
+    qDebug() << "GET" << request.url().toString();
     return networkAccessManager->get(request);
 }
 
+int SlackClient::scheduleGet(QString method, QMap<QString, QString> params, RequestScheduler::Priority priority, RequestScheduler::Handler handler) {
+    return scheduler->get(method, getRequest(method, params), priority, handler);
+}
+
+QString SlackClient::requestKey(const QString &method, const QMap<QString,QString> &params) {
+    QString key = method;
+    for (QMap<QString,QString>::const_iterator i = params.constBegin(); i != params.constEnd(); ++i) {
+        key += QLatin1Char('&') + i.key() + QLatin1Char('=') + i.value();
+    }
+    return key;
+}
+
+// Returns true if an equal load is already pending, whose result signal
+// will also answer this caller
+bool SlackClient::isLoadPending(const QString &key) {
+    if (pendingLoads.contains(key)) {
+        qDebug() << "Load already pending" << key;
+        return true;
+    }
+    return false;
+}
+
+void SlackClient::cancelLoads(QString channelId) {
+    QHash<QString,PendingLoad>::iterator i = pendingLoads.begin();
+    while (i != pendingLoads.end()) {
+        // Loads already sent are left to finish, their result is cached
+        if (i.value().channelId == channelId && scheduler->cancel(i.value().requestId)) {
+            i = pendingLoads.erase(i);
+        }
+        else {
+            ++i;
+        }
+    }
+}
+
 QNetworkReply* SlackClient::executePost(QString method, const QMap<QString, QString>& data) {
     QUrlQuery query;
 
@@ -426,8 +610,21 @@ void SlackClient::handleAccessTokenReply() {
 
 void SlackClient::logout() {
     config->clearAccessToken();
+    reconnectPolicy->reset();
+    snapshotTimer->stop();
+    scheduler->clear();
+    pendingLoads.clear();
     stream->disconnectFromHost();
     Storage::clear();
+    Storage::removeSnapshot();
+    contentCache.clear();
+    channelListModel->reload();
+
+    foreach (MessageListModel *model, messageListModels) {
+        if (model) {
+            model->clear();
+        }
+    }
 }
 
 void SlackClient::testLogin() {
@@ -471,27 +668,41 @@ void SlackClient::handleTestLoginReply() {
 
 void SlackClient::init() {
   qDebug() << "Start init";
+
+  if (Storage::channels().isEmpty() && Storage::loadSnapshot()) {
+      qDebug() << "Workspace restored from snapshot";
+      emit snapshotRestored();
+  }
+
   loadUsers();
 }
 
 void SlackClient::loadUsers() {
   qDebug() << "Start load users";
-  QNetworkReply* reply = executeGet("users.list");
-
-  connect(reply, &QNetworkReply::finished, [reply,this]() {
-    QJsonObject data = getResult(reply);
-    if (isError(data)) {
-      qDebug() << "User load failed";
-      emit loadUsersFail();
-    }
-    else {
-      qDebug() << "Load users completed";
-      parseUsers(data);
-      emit loadUsersSuccess();
-      loadConversations();
-    }
-
-    reply->deleteLater();
+  scheduleGet("users.list", QMap<QString,QString>(), RequestScheduler::Normal, [this](QNetworkReply *reply) {
+    bool ok = isOk(reply);
+    QByteArray body = reply->readAll();
+
+    pipeline->run<UserList>("users.list", [ok,body,this]() {
+      UserList result;
+      QJsonObject data = ok ? parseJson(body) : QJsonObject();
+      result.ok = !isError(data);
+      if (result.ok) {
+        result.users = parseUsers(data);
+      }
+      return result;
+    }, [this](const UserList &result) {
+      if (!result.ok) {
+        qDebug() << "User load failed";
+        emit loadUsersFail();
+      }
+      else {
+        qDebug() << "Load users completed";
+        saveUsers(result.users);
+        emit loadUsersSuccess();
+        loadConversations();
+      }
+    });
   });
 }
 
@@ -505,7 +716,11 @@ void SlackClient::start() {
     connect(reply, &QNetworkReply::finished, [reply,this]() {
         QJsonObject data = getResult(reply);
 
-        if (isError(data)) {
+        if (isError(data) && reconnectPolicy->attempts() > 0 && !config->accessToken().isEmpty()) {
+            qDebug() << "Reconnect failed";
+            reconnectPolicy->schedule();
+        }
+        else if (isError(data)) {
             qDebug() << "Connect result error";
             emit disconnected();
             emit initFail();
@@ -515,7 +730,9 @@ void SlackClient::start() {
             stream->listen(url);
             qDebug() << "Connect completed";
 
-            Storage::clearChannelMessages();
+            // Saved once the connection has been stable for a while
+            snapshotTimer->start();
+            catchUpChannels();
             emit initSuccess();
         }
 
@@ -523,110 +740,164 @@ void SlackClient::start() {
     });
 }
 
-QVariantMap SlackClient::parseChannel(QJsonObject channel) {
-    QVariantMap data;
-    data.insert("id", channel.value("id").toVariant());
-    data.insert("type", QVariant("channel"));
-    data.insert("category", QVariant("channel"));
-    data.insert("name", channel.value("name").toVariant());
-    data.insert("presence", QVariant("none"));
-    data.insert("isOpen", channel.value("is_member").toVariant());
-    data.insert("lastRead", channel.value("last_read").toVariant());
-    data.insert("unreadCount", channel.value("unread_count_display").toVariant());
-    data.insert("userId", QVariant());
+Channel SlackClient::parseChannel(QJsonObject channel) {
+    Channel data;
+    data.id = channel.value("id").toString();
+    data.type = "channel";
+    data.category = "channel";
+    data.name = channel.value("name").toString();
+    data.presence = "none";
+    data.isOpen = channel.value("is_member").toBool();
+    data.lastRead = channel.value("last_read").toString();
+    data.unreadCount = channel.value("unread_count_display").toInt();
     return data;
 }
 
-QVariantMap SlackClient::parseGroup(QJsonObject group) {
-    QVariantMap data;
+Channel SlackClient::parseGroup(QJsonObject group) {
+    Channel data;
 
     if (group.value("is_mpim").toBool()) {
-        data.insert("type", QVariant("mpim"));
-        data.insert("category", QVariant("chat"));
+        data.type = "mpim";
+        data.category = "chat";
 
         QStringList members;
         QJsonArray memberList = group.value("members").toArray();
         foreach (const QJsonValue &member, memberList) {
-            QVariant memberId = member.toVariant();
+            QString memberId = member.toString();
 
             if (memberId != config->userId()) {
-                members << Storage::user(memberId).value("name").toString();
+                members << Storage::user(memberId).name;
             }
         }
-        data.insert("name", QVariant(members.join(", ")));
+        data.name = members.join(", ");
     }
     else {
-        data.insert("type", QVariant("group"));
-        data.insert("category", QVariant("channel"));
-        data.insert("name", group.value("name").toVariant());
+        data.type = "group";
+        data.category = "channel";
+        data.name = group.value("name").toString();
     }
 
-    data.insert("id", group.value("id").toVariant());
-    data.insert("presence", QVariant("none"));
-    data.insert("isOpen", group.value("is_open").toVariant());
-    data.insert("lastRead", group.value("last_read").toVariant());
-    data.insert("unreadCount", group.value("unread_count_display").toVariant());
-    data.insert("userId", QVariant());
+    data.id = group.value("id").toString();
+    data.presence = "none";
+    data.isOpen = group.value("is_open").toBool();
+    data.lastRead = group.value("last_read").toString();
+    data.unreadCount = group.value("unread_count_display").toInt();
     return data;
 }
 
-QVariantMap SlackClient::parseChat(QJsonObject chat) {
-  QVariantMap data;
+Channel SlackClient::parseChat(QJsonObject chat) {
+  Channel data;
 
-  QVariant userId = chat.value("user").toVariant();
-  QVariantMap user = Storage::user(userId);
+  QString userId = chat.value("user").toString();
+  User user = Storage::user(userId);
 
   QString name;
-  if (userId.toString() == config->userId()) {
-    name = user.value("name").toString() + " (you)";
+  if (userId == config->userId()) {
+    name = user.name + " (you)";
   }
   else {
-    name = user.value("name").toString();
+    name = user.name;
   }
 
-  data.insert("type", QVariant("im"));
-  data.insert("category", QVariant("chat"));
-  data.insert("id", chat.value("id").toVariant());
-  data.insert("userId", userId);
-  data.insert("name", QVariant(name));
-  data.insert("presence", user.value("presence"));
-  data.insert("isOpen", chat.value("is_open").toVariant());
-  data.insert("lastRead", chat.value("last_read").toVariant());
-  data.insert("unreadCount", chat.value("unread_count_display").toVariant());
+  data.type = "im";
+  data.category = "chat";
+  data.id = chat.value("id").toString();
+  data.userId = userId;
+  data.name = name;
+  data.presence = user.presence;
+  data.isOpen = chat.value("is_open").toBool();
+  data.lastRead = chat.value("last_read").toString();
+  data.unreadCount = chat.value("unread_count_display").toInt();
 
   return data;
 }
 
-void SlackClient::parseUsers(QJsonObject data) {
+QList<User> SlackClient::parseUsers(QJsonObject data) {
+    QList<User> users;
+
     foreach (const QJsonValue &value, data.value("members").toArray()) {
         QJsonObject user = value.toObject();
         QJsonObject profile = user.value("profile").toObject();
-        QVariant presence;
+
+        User data;
+        data.id = user.value("id").toString();
+        if (profile.contains("display_name")) {
+            data.name = profile.value("display_name").toString();
+        } else {
+            data.name = user.value("name").toString();
+        }
+
         if (profile.value("always_active").toBool()) {
-            presence = QVariant("active");
+            data.presence = "active";
         }
         else {
-            presence = QVariant("away");
+            data.presence = "away";
         }
+        users.append(data);
+    }
 
-        QVariantMap data;
-        data.insert("id", user.value("id").toVariant());
-        if (profile.contains("display_name")) {
-            data.insert("name", profile.value("display_name").toVariant());
-        } else {
-            data.insert("name", user.value("name").toVariant());
-        }
-        data.insert("presence", presence);
-        Storage::saveUser(data);
+    return users;
+}
+
+void SlackClient::saveUsers(const QList<User> &users) {
+    QSet<QString> userIds;
+
+    foreach (const User &user, users) {
+        Storage::saveUser(user);
+        userIds.insert(user.id);
     }
+
+    Storage::removeStaleUsers(userIds);
 }
 
 QVariantList SlackClient::getChannels() {
-    return Storage::channels();
+    QVariantList channels;
+    channels.reserve(Storage::channels().size());
+
+    foreach (const Channel &channel, Storage::channels()) {
+        channels.append(channel.toMap());
+    }
+    return channels;
 }
 
 QVariant SlackClient::getChannel(QString channelId) {
-    return Storage::channel(QVariant(channelId));
+    return Storage::channel(channelId).toMap();
+}
+
+QVariantMap SlackClient::getMessageStats() {
+    QVariantMap stats;
+    QHash<QString,MessageStats> channelStats = Storage::channelMessageStats();
+
+    for (QHash<QString,MessageStats>::const_iterator i = channelStats.constBegin(); i != channelStats.constEnd(); ++i) {
+        QVariantMap data;
+        data.insert("messages", QVariant(i.value().messages));
+        data.insert("bytes", QVariant(i.value().bytes));
+        stats.insert(i.key(), data);
+    }
+    return stats;
+}
+
+QVariantMap SlackClient::getEventStats() {
+    QVariantMap stats;
+
+    for (QHash<QString,EventStats>::const_iterator i = eventStats.constBegin(); i != eventStats.constEnd(); ++i) {
+        QVariantMap data;
+        data.insert("count", QVariant(i.value().count));
+        data.insert("nsecs", QVariant(i.value().nsecs));
+        data.insert("handled", QVariant(eventHandlers.contains(i.key())));
+        stats.insert(i.key(), data);
+    }
+    return stats;
+}
+
+QVariantMap SlackClient::getReconnectStats() {
+    QVariantMap stats;
+    stats.insert("attempts", QVariant(reconnectPolicy->attempts()));
+    stats.insert("lastDelay", QVariant(reconnectPolicy->lastDelay()));
+    stats.insert("nextAttemptAt", QVariant(reconnectPolicy->nextAttemptAt()));
+    stats.insert("pending", QVariant(reconnectPolicy->isPending()));
+    stats.insert("suspended", QVariant(reconnectPolicy->isSuspended()));
+    return stats;
 }
 
 QString SlackClient::historyMethod(QString type) {
@@ -657,75 +928,84 @@ void SlackClient::loadConversations(QString cursor) {
   if (!cursor.isEmpty()) {
       params.insert("cursor", cursor);
   }
+  else {
+      loadedChannelIds.clear();
+  }
 
-  QNetworkReply* reply = executeGet("conversations.list", params);
-  connect(reply, &QNetworkReply::finished, [reply,this]() {
+  scheduleGet("conversations.list", params, RequestScheduler::Normal, [this](QNetworkReply *reply) {
     QJsonObject data = getResult(reply);
 
     if (isError(data)) {
       qDebug() << "Conversation load failed";
+      return;
     }
-    else {
-      auto combinator = AsyncFuture::combine();
-      QString nextCursor = data.value("response_metadata").toObject().value("next_cursor").toString();
 
-      foreach (const QJsonValue &value, data.value("channels").toArray()) {
-        QJsonObject channel = value.toObject();
+    foreach (const QJsonValue &value, data.value("channels").toArray()) {
+      QJsonObject channel = value.toObject();
+      QString channelId = channel.value("id").toString();
+      loadedChannelIds.insert(channelId);
 
-        QString infoMethod;
-        if (channel.value("is_channel").toBool()) {
-          infoMethod = "channels.info";
-        }
-        else if (channel.value("is_group").toBool()) {
-          infoMethod = "groups.info";
-        }
-        else {
-          infoMethod = "conversations.info";
-        }
+      if (!Storage::channel(channelId).isValid()) {
+        Storage::saveChannel(parseConversation(channel));
+      }
 
-        QMap<QString,QString> params;
-        params.insert("channel", channel.value("id").toString());
-        QNetworkReply* infoReply = executeGet(infoMethod, params);
+      loadConversationInfo(channel);
+    }
 
-        combinator << AsyncFuture::observe(infoReply, &QNetworkReply::finished).future();
-        connect(infoReply, &QNetworkReply::finished, [infoReply,infoMethod,this]() {
-            QJsonObject infoData = getResult(infoReply).value(infoMethod == "groups.info" ? "group" : "channel").toObject();
-            QVariantMap channel;
+    QString nextCursor = data.value("response_metadata").toObject().value("next_cursor").toString();
+    if (nextCursor.isEmpty()) {
+      Storage::removeStaleChannels(loadedChannelIds);
+      start();
+    }
+    else {
+      loadConversations(nextCursor);
+    }
+  });
+}
 
-            if (infoData.value("is_im").toBool()) {
-              channel = parseChat(infoData);
-            }
-            else if (infoData.value("is_channel").toBool()) {
-              channel = parseChannel(infoData);
-            }
-            else {
-              channel = parseGroup(infoData);
-            }
+void SlackClient::loadConversationInfo(const QJsonObject &channel) {
+  QString infoMethod;
+  if (channel.value("is_channel").toBool()) {
+    infoMethod = "channels.info";
+  }
+  else if (channel.value("is_group").toBool()) {
+    infoMethod = "groups.info";
+  }
+  else {
+    infoMethod = "conversations.info";
+  }
 
-            Storage::saveChannel(channel);
-            infoReply->deleteLater();
-        });
-      }
+  QMap<QString,QString> params;
+  params.insert("channel", channel.value("id").toString());
 
-      AsyncFuture::observe(combinator.future()).subscribe([nextCursor,this]() {
-          if (nextCursor.isEmpty()) {
-              start();
-          }
-          else {
-              loadConversations(nextCursor);
-          }
-      });
-    }
+  scheduleGet(infoMethod, params, RequestScheduler::Background, [infoMethod,this](QNetworkReply *reply) {
+    QJsonObject infoData = getResult(reply).value(infoMethod == "groups.info" ? "group" : "channel").toObject();
+    Channel channel = parseConversation(infoData);
 
-    reply->deleteLater();
+    if (channel.isValid()) {
+      Storage::saveChannel(channel);
+      queueChannelUpdate(channel.id);
+    }
   });
 }
 
+Channel SlackClient::parseConversation(const QJsonObject &data) {
+  if (data.value("is_im").toBool()) {
+    return parseChat(data);
+  }
+  else if (data.value("is_channel").toBool()) {
+    return parseChannel(data);
+  }
+  else {
+    return parseGroup(data);
+  }
+}
+
 void SlackClient::joinChannel(QString channelId) {
-    QVariantMap channel = Storage::channel(QVariant(channelId));
+    Channel channel = Storage::channel(channelId);
 
     QMap<QString,QString> params;
-    params.insert("name", channel.value("name").toString());
+    params.insert("name", channel.name);
 
     QNetworkReply* reply = executeGet("channels.join", params);
     connect(reply, &QNetworkReply::finished, [reply,this]() {
@@ -772,10 +1052,10 @@ void SlackClient::leaveGroup(QString groupId) {
 }
 
 void SlackClient::openChat(QString chatId) {
-    QVariantMap channel = Storage::channel(QVariant(chatId));
+    Channel channel = Storage::channel(chatId);
 
     QMap<QString,QString> params;
-    params.insert("user", channel.value("userId").toString());
+    params.insert("user", channel.userId);
 
     QNetworkReply* reply = executeGet("im.open", params);
     connect(reply, &QNetworkReply::finished, [reply,this]() {
@@ -812,29 +1092,131 @@ void SlackClient::loadHistory(QString type, QString channelId, QString latest) {
   params.insert("latest", latest);
   params.insert("inclusive", "0");
 
-  QNetworkReply* reply = executeGet(historyMethod(type), params);
-  connect(reply, &QNetworkReply::finished, [reply,channelId,this]() {
-      QJsonObject data = getResult(reply);
+  QString method = historyMethod(type);
+  QString key = requestKey(method, params);
+  if (isLoadPending(key)) {
+      return;
+  }
+
+  PendingLoad load;
+  load.channelId = channelId;
+  load.requestId = scheduleGet(method, params, RequestScheduler::Interactive, [key,channelId,this](QNetworkReply *reply) {
+      parseMessagePage(reply, channelId, [key,channelId,this](const MessagePage &page) {
+          pendingLoads.remove(key);
 
-      if (isError(data)) {
-          reply->deleteLater();
-          emit loadHistoryFail();
-          return;
-      }
+          if (!page.ok) {
+              emit loadHistoryFail();
+              return;
+          }
 
-      QVariantList messages = parseMessages(data);
-      bool hasMore = data.value("has_more").toBool();
-      Storage::prependChannelMessages(channelId, messages);
+          MessageListModel *model = messageListModel(channelId);
+          Storage::prependChannelMessages(channelId, page.messages);
+          model->prependMessages(page.messages);
 
-      emit loadHistorySuccess(channelId, messages, hasMore);
-      reply->deleteLater();
+          // Older history would not be kept, so stop asking for it
+          if (page.hasMore && model->isFull()) {
+              qDebug() << "History limit reached" << channelId << Storage::channelMessageLimit();
+          }
+          emit loadHistorySuccess(channelId, page.hasMore && !model->isFull());
+      });
   });
+  pendingLoads.insert(key, load);
+}
+
+// Cached messages are kept over reconnects; only what was missed while
+// disconnected is fetched for each channel that has them
+void SlackClient::catchUpChannels() {
+    foreach (const QString &channelId, Storage::cachedChannelIds()) {
+        Channel channel = Storage::channel(channelId);
+        Message last = Storage::lastChannelMessage(channelId);
+
+        if (!channel.isValid() || last.timestamp.isEmpty()) {
+            resetChannelMessages(channelId);
+        }
+        else {
+            catchUpChannel(channel.type, channelId, last.timestamp);
+        }
+    }
+}
+
+// Drops the cached messages of a channel. A model showing them is loaded
+// again, so that it keeps matching the buffer realtime messages go to.
+void SlackClient::resetChannelMessages(const QString &channelId) {
+    Storage::removeChannelMessages(channelId);
+
+    MessageListModel *model = messageListModels.value(channelId);
+    if (model) {
+        model->clear();
+
+        Channel channel = Storage::channel(channelId);
+        if (channel.isValid()) {
+            loadMessages(channel.type, channelId);
+        }
+    }
+}
+
+void SlackClient::catchUpChannel(QString type, QString channelId, QString oldest, int attempt) {
+    QMap<QString,QString> params;
+    params.insert("channel", channelId);
+    params.insert("count", "100");
+    params.insert("oldest", oldest);
+    params.insert("inclusive", "0");
+
+    scheduleGet(historyMethod(type), params, RequestScheduler::Background, [type,channelId,oldest,attempt,this](QNetworkReply *reply) {
+        parseMessagePage(reply, channelId, [type,channelId,oldest,attempt,this](const MessagePage &page) {
+            if (!Storage::channelMessagesExist(channelId)) {
+                // Dropped meanwhile, e.g. on logout
+                return;
+            }
+
+            MessageListModel *model = messageListModels.value(channelId);
+
+            if (!page.ok && attempt + 1 < maxCatchUpAttempts) {
+                // Keep the cache, merging handles what arrives meanwhile
+                QTimer::singleShot(catchUpRetryDelay << attempt, this, [type,channelId,oldest,attempt,this]() {
+                    if (Storage::channelMessagesExist(channelId)) {
+                        catchUpChannel(type, channelId, oldest, attempt + 1);
+                    }
+                });
+                return;
+            }
+
+            if (!page.ok) {
+                resetChannelMessages(channelId);
+                return;
+            }
+
+            if (page.messages.isEmpty()) {
+                return;
+            }
+
+            if (page.hasMore) {
+                // Missed more than a page, so the cache would have a gap
+                Storage::setChannelMessages(channelId, page.messages);
+                if (model) {
+                    model->setMessages(page.messages);
+                }
+                emit loadMessagesSuccess(channelId, !model || !model->isFull());
+            }
+            else if (Storage::mergeChannelMessages(channelId, page.messages)) {
+                if (model) {
+                    foreach (const Message &message, page.messages) {
+                        model->appendMessage(message);
+                    }
+                }
+            }
+            else if (model) {
+                model->setMessages(Storage::channelMessages(channelId));
+            }
+        });
+    });
 }
 
 void SlackClient::loadMessages(QString type, QString channelId) {
     if (Storage::channelMessagesExist(channelId)) {
-        QVariantList messages = Storage::channelMessages(channelId);
-        emit loadMessagesSuccess(channelId, messages, true);
+        MessageListModel *model = messageListModel(channelId);
+        model->setMessages(Storage::channelMessages(channelId));
+        emit loadMessagesSuccess(channelId, !model->isFull());
         return;
     }
 
@@ -842,42 +1224,71 @@ void SlackClient::loadMessages(QString type, QString channelId) {
     params.insert("channel", channelId);
     params.insert("count", "20");
 
-    QNetworkReply* reply = executeGet(historyMethod(type), params);
-    reply->setProperty("channelId", channelId);
-    connect(reply, SIGNAL(finished()), this, SLOT(handleLoadMessagesReply()));
-}
+    QString method = historyMethod(type);
+    QString key = requestKey(method, params);
+    if (isLoadPending(key)) {
+        return;
+    }
 
-void SlackClient::handleLoadMessagesReply() {
-    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+    PendingLoad load;
+    load.channelId = channelId;
+    load.requestId = scheduleGet(method, params, RequestScheduler::Interactive, [key,channelId,this](QNetworkReply *reply) {
+        parseMessagePage(reply, channelId, [key,channelId,this](const MessagePage &page) {
+            pendingLoads.remove(key);
 
-    QJsonObject data = getResult(reply);
+            if (!page.ok) {
+                emit loadMessagesFail();
+                return;
+            }
 
-    if (isError(data)) {
-        reply->deleteLater();
-        emit loadMessagesFail();
-        return;
-    }
+            Storage::setChannelMessages(channelId, page.messages);
+            messageListModel(channelId)->setMessages(page.messages);
+            emit loadMessagesSuccess(channelId, page.hasMore);
+        });
+    });
+    pendingLoads.insert(key, load);
+}
 
-    QVariantList messages = parseMessages(data);
-    bool hasMore = data.value("has_more").toBool();
-    QString channelId = reply->property("channelId").toString();
-    Storage::setChannelMessages(channelId, messages);
+void SlackClient::parseMessagePage(QNetworkReply *reply, QString channelId, std::function<void(const MessagePage&)> done) {
+    bool ok = isOk(reply);
+    QByteArray body = reply->readAll();
 
-    emit loadMessagesSuccess(channelId, messages, hasMore);
-    reply->deleteLater();
+    pipeline->run<MessagePage>(channelId, [ok,body,channelId,this]() {
+        MessagePage page;
+        QJsonObject data = ok ? parseJson(body) : QJsonObject();
+        page.ok = !isError(data);
+
+        if (page.ok) {
+            page.messages = parseMessages(data, channelId);
+            page.hasMore = data.value("has_more").toBool();
+        }
+        return page;
+    }, done);
 }
 
-QVariantList SlackClient::parseMessages(const QJsonObject data) {
+QList<Message> SlackClient::parseMessages(const QJsonObject data, const QString &channelId) {
     QJsonArray messageList = data.value("messages").toArray();
-    QVariantList messages;
-
-    foreach (const QJsonValue &value, messageList) {
-        QJsonObject message = value.toObject();
-        messages << getMessageData(message);
+    QList<Message> messages;
+    messages.reserve(messageList.size());
+
+    // Pages come newest first, so they are sorted once reversed
+    for (int i = messageList.size() - 1; i >= 0; i--) {
+        QJsonObject message = messageList.at(i).toObject();
+        // History messages do not name their channel
+        if (!message.contains("channel")) {
+            message.insert("channel", channelId);
+        }
+        // Formatted when first shown, see MessageListModel
+        messages << getMessageData(message, false);
     }
-    std::sort(messages.begin(), messages.end(), [](const QVariant &a, const QVariant &b) -> bool {
-        return a.toMap().value("time").toDateTime() < b.toMap().value("time").toDateTime();
+    bool sorted = std::is_sorted(messages.constBegin(), messages.constEnd(), [](const Message &a, const Message &b) -> bool {
+        return a.isBefore(b);
     });
+    if (!sorted) {
+        std::sort(messages.begin(), messages.end(), [](const Message &a, const Message &b) -> bool {
+            return a.isBefore(b);
+        });
+    }
 
     return messages;
 }
@@ -905,15 +1316,12 @@ void SlackClient::markChannel(QString type, QString channelId, QString time) {
     params.insert("channel", channelId);
     params.insert("ts", time);
 
-    QNetworkReply* reply = executeGet(markMethod(type), params);
-    connect(reply, &QNetworkReply::finished, [reply,this]() {
+    scheduleGet(markMethod(type), params, RequestScheduler::Normal, [this](QNetworkReply *reply) {
         QJsonObject data = getResult(reply);
 
         if (isError(data)) {
             qDebug() << "Mark conversation failed";
         }
-
-        reply->deleteLater();
     });
 }
 
@@ -978,78 +1386,99 @@ void SlackClient::postImage(QString channelId, QString imagePath, QString title,
     });
 }
 
-QVariantMap SlackClient::getMessageData(const QJsonObject message) {
-    qlonglong multiplier = 1000;
-    QStringList timeParts = message.value("ts").toString().split(".");
-    QString timePart = timeParts.value(0);
-    QString indexPart = timeParts.value(1);
-
-    qlonglong timestamp = timePart.toLongLong() * multiplier + indexPart.toLongLong();
-    QDateTime time = QDateTime::fromMSecsSinceEpoch(timestamp);
+Message SlackClient::getMessageData(const QJsonObject message, bool format) {
+    Message data;
+    data.type = message.value("type").toString();
+    data.timestamp = message.value("ts").toString();
+    data.ts = SlackTimestamp::parse(data.timestamp);
+    data.time = QDateTime::fromMSecsSinceEpoch(data.ts.toMSecsSinceEpoch());
+    data.timegroup = SlackTimestamp::dayLabel(data.time.date());
+    data.channel = Storage::intern(message.value("channel").toString());
+    data.user = user(message);
+    data.source = message;
 
-    QVariantMap data;
-    data.insert("type", message.value("type").toVariant());
-    data.insert("time", QVariant::fromValue(time));
-    data.insert("timegroup", QVariant::fromValue(time.toString("MMMM d, yyyy")));
-    data.insert("timestamp", message.value("ts").toVariant());
-    data.insert("channel", message.value("channel").toVariant());
-    data.insert("user", user(message));
-    data.insert("attachments", getAttachments(message));
-    data.insert("images", getImages(message));
-    data.insert("content", QVariant(getContent(message)));
+    if (format) {
+        formatMessage(data);
+    }
 
     return data;
 }
 
-QVariantMap SlackClient::user(const QJsonObject &data) {
+void SlackClient::formatMessage(Message &message) {
+    if (message.isFormatted()) {
+        return;
+    }
+
+    message.attachments = getAttachments(message.source);
+    message.images = getImages(message.source);
+    message.content = getContent(message.source);
+    message.source = QJsonObject();
+}
+
+User SlackClient::user(const QJsonObject &data) {
     QString type = data.value("subtype").toString("default");
-    QVariant userId;
+    QString userId;
 
     if (type == "bot_message") {
-        userId = data.value("bot_id").toVariant();
+        userId = data.value("bot_id").toString();
     }
     else if (type == "file_comment") {
-        userId = data.value("comment").toObject().value("user").toVariant();
+        userId = data.value("comment").toObject().value("user").toString();
     }
     else {
-        userId = data.value("user").toVariant();
+        userId = data.value("user").toString();
     }
 
-    if (!userId.isValid()) {
+    if (userId.isEmpty()) {
         qDebug() << "User not found for message";
         qDebug() << data;
     }
 
-    QVariantMap userData = Storage::user(userId);
+    User userData = Storage::user(userId);
 
-    if (userData.isEmpty()) {
-        userData.insert("id", data.value("user").toVariant());
-        userData.insert("name", QVariant("Unknown"));
-        userData.insert("presence", QVariant("away"));
+    if (!userData.isValid()) {
+        userData.id = Storage::intern(data.value("user").toString());
+        userData.name = "Unknown";
+        userData.presence = "away";
     }
 
     QString username = data.value("username").toString();
     if (!username.isEmpty()) {
         QRegularExpression newUserPattern("<@([A-Z0-9]+)\\|([^>]+)>");
         username.replace(newUserPattern, "\\2");
-        userData.insert("name", username);
+        userData.name = username;
     }
 
     return userData;
 }
 
 QString SlackClient::getContent(QJsonObject message) {
-    QString content = message.value("text").toString();
+    QString timestamp = message.value("ts").toString();
+    QString key;
+    QString content;
+
+    if (!timestamp.isEmpty()) {
+        QString edited = message.value("edited").toObject().value("ts").toString();
+        key = ContentCache::key(message.value("channel").toString(), timestamp, edited);
+
+        if (contentCache.find(key, content)) {
+            return content;
+        }
+    }
 
+    content = message.value("text").toString();
     findNewUsers(content);
-    MessageFormatter::replaceUserInfo(content);
-    MessageFormatter::replaceTargetInfo(content);
-    MessageFormatter::replaceChannelInfo(content);
-    MessageFormatter::replaceLinks(content);
+
+    quint64 generation = Storage::directoryGeneration();
+    QStringList references;
+    MessageFormatter::replaceTokens(content, MessageFormatter::AllTokens, &references);
     MessageFormatter::replaceSpecialCharacters(content);
     MessageFormatter::replaceMarkdown(content);
     MessageFormatter::replaceEmoji(content);
 
+    if (!key.isEmpty()) {
+        contentCache.insert(key, content, references, generation);
+    }
     return content;
 }
 
@@ -1221,12 +1650,11 @@ void SlackClient::findNewUsers(const QString &message) {
         QRegularExpressionMatch match = i.next();
         QString id = match.captured(1);
 
-        if (Storage::user(id).isEmpty()) {
-            QString name = match.captured(2);
-            QVariantMap data;
-            data.insert("id", QVariant(id));
-            data.insert("name", QVariant(name));
-            data.insert("presence", QVariant("active"));
+        if (!Storage::user(id).isValid()) {
+            User data;
+            data.id = id;
+            data.name = match.captured(2);
+            data.presence = "active";
             Storage::saveUser(data);
         }
     }
@@ -7,24 +7,57 @@
 #include <QFile>
 #include <QJsonObject>
 #include <QUrl>
+#include <QSet>
 #include <QTimer>
 #include <QtNetwork/QNetworkAccessManager>
 #include <QtNetwork/QNetworkReply>
 
 #include "slackconfig.h"
 #include "slackstream.h"
+#include "storage.h"
+#include "requestscheduler.h"
+#include "workerpipeline.h"
+#include "channellistmodel.h"
+#include "messagelistmodel.h"
+#include "contentcache.h"
+#include "reconnectpolicy.h"
+
+struct MessagePage
+{
+    MessagePage() : ok(false), hasMore(false) {}
+
+    bool ok;
+    QList<Message> messages;
+    bool hasMore;
+};
+
+struct UserList
+{
+    UserList() : ok(false) {}
+
+    bool ok;
+    QList<User> users;
+};
 
 class SlackClient : public QObject
 {
     Q_OBJECT
+    Q_PROPERTY(ChannelListModel* channelListModel READ getChannelListModel CONSTANT)
 public:
     explicit SlackClient(QObject *parent = 0);
+    ~SlackClient();
+
+    ChannelListModel *getChannelListModel() const;
 
     Q_INVOKABLE void setAppActive(bool active);
     Q_INVOKABLE void setActiveWindow(QString windowId);
 
     Q_INVOKABLE QVariantList getChannels();
     Q_INVOKABLE QVariant getChannel(QString channelId);
+    Q_INVOKABLE QVariantMap getMessageStats();
+    Q_INVOKABLE QVariantMap getEventStats();
+    Q_INVOKABLE QVariantMap getReconnectStats();
+    Q_INVOKABLE MessageListModel *messageListModel(QString channelId);
 
 signals:
     void testConnectionFail();
@@ -37,22 +70,23 @@ signals:
     void accessTokenSuccess(QString userId, QString teamId, QString team);
     void accessTokenFail();
 
-    void loadMessagesSuccess(QString channelId, QVariantList messages, bool hasMore);
+    void loadMessagesSuccess(QString channelId, bool hasMore);
     void loadMessagesFail();
-    void loadHistorySuccess(QString channelId, QVariantList messages, bool hasMore);
+    void loadHistorySuccess(QString channelId, bool hasMore);
     void loadHistoryFail();
 
     void initFail();
     void initSuccess();
+    void snapshotRestored();
 
     void reconnectFail();
     void reconnectAccessTokenFail();
 
     void messageReceived(QVariantMap message);
-    void channelUpdated(QVariantMap channel);
     void channelJoined(QVariantMap channel);
     void channelLeft(QVariantMap channel);
-    void userUpdated(QVariantMap user);
+    void channelsUpdated(QStringList channelIds);
+    void usersUpdated(QStringList userIds);
 
     void postImageSuccess();
     void postImageFail();
@@ -77,7 +111,7 @@ public slots:
 
     void loadHistory(QString type, QString channelId, QString latest);
     void loadMessages(QString type, QString channelId);
-    void handleLoadMessagesReply();
+    void cancelLoads(QString channelId);
 
     void logout();
     void loadUsers();
@@ -96,6 +130,10 @@ public slots:
     void handleStreamEnd();
     void handleStreamMessage(QJsonObject message);
 
+private slots:
+    void emitPendingUpdates();
+    void handleScheduledReconnect();
+    void saveSnapshot();
 
 private:
     bool appActive;
@@ -105,14 +143,41 @@ private:
     QNetworkReply *executePostWithFile(QString method, const QMap<QString, QString>&, QFile *file);
 
     QNetworkReply* executeGet(QString method, QMap<QString,QString> params = QMap<QString,QString>());
+    int scheduleGet(QString method, QMap<QString,QString> params, RequestScheduler::Priority priority, RequestScheduler::Handler handler);
+    static QString requestKey(const QString &method, const QMap<QString,QString> &params);
+    bool isLoadPending(const QString &key);
+    QNetworkRequest getRequest(QString method, const QMap<QString,QString> &params);
 
     static QString toString(const QJsonObject &data);
 
     bool isOk(const QNetworkReply *reply);
     bool isError(const QJsonObject &data);
     QJsonObject getResult(QNetworkReply *reply);
+    static QJsonObject parseJson(const QByteArray &body);
 
     void loadConversations(QString cursor = QString());
+    void loadConversationInfo(const QJsonObject &channel);
+
+    void catchUpChannels();
+    void catchUpChannel(QString type, QString channelId, QString oldest, int attempt = 0);
+    void resetChannelMessages(const QString &channelId);
+
+    static const int snapshotDelay = 60000;
+    static const int maxCatchUpAttempts = 3;
+    static const int catchUpRetryDelay = 5000;
+
+    typedef void (SlackClient::*EventHandler)(QJsonObject);
+
+    // Events received per RTM type and the time spent handling them on the
+    // main thread; work handed to the pipeline is not included
+    struct EventStats {
+        EventStats() : count(0), nsecs(0) {}
+
+        qint64 count;
+        qint64 nsecs;
+    };
+
+    void registerEventHandler(const QString &type, EventHandler handler);
 
     void parseMessageUpdate(QJsonObject message);
     void parseChannelUpdate(QJsonObject message);
@@ -124,8 +189,13 @@ private:
     void parsePresenceChange(QJsonObject message);
     void parseNotification(QJsonObject message);
 
-    QVariantList parseMessages(const QJsonObject data);
-    QVariantMap getMessageData(const QJsonObject message);
+    void queueChannelUpdate(const QString &channelId);
+    void queueUserUpdate(const QString &userId);
+
+    QList<Message> parseMessages(const QJsonObject data, const QString &channelId);
+    void parseMessagePage(QNetworkReply *reply, QString channelId, std::function<void(const MessagePage&)> done);
+    Message getMessageData(const QJsonObject message, bool format = true);
+    void formatMessage(Message &message);
 
     QString getContent(QJsonObject message);
     QVariantList getAttachments(QJsonObject message);
@@ -134,17 +204,19 @@ private:
     QVariantList getAttachmentFields(QJsonObject attachment);
     QVariantList getAttachmentImages(QJsonObject attachment);
 
-    QVariantMap parseChannel(QJsonObject data);
-    QVariantMap parseGroup(QJsonObject group);
-    QVariantMap parseChat(QJsonObject chat);
+    Channel parseConversation(const QJsonObject &data);
+    Channel parseChannel(QJsonObject data);
+    Channel parseGroup(QJsonObject group);
+    Channel parseChat(QJsonObject chat);
 
-    void parseUsers(QJsonObject data);
+    QList<User> parseUsers(QJsonObject data);
+    void saveUsers(const QList<User> &users);
     void findNewUsers(const QString &message);
 
     void sendNotification(QString channelId, QString title, QString content);
     void clearNotifications();
 
-    QVariantMap user(const QJsonObject &data);
+    User user(const QJsonObject &data);
 
     QString historyMethod(QString type);
     QString markMethod(QString type);
@@ -152,9 +224,33 @@ private:
     QPointer<QNetworkAccessManager> networkAccessManager;
     QPointer<SlackConfig> config;
     QPointer<SlackStream> stream;
-    QPointer<QTimer> reconnectTimer;
+    QPointer<ReconnectPolicy> reconnectPolicy;
+    QPointer<QTimer> updateTimer;
+    QPointer<QTimer> snapshotTimer;
+    QPointer<RequestScheduler> scheduler;
+    QPointer<WorkerPipeline> pipeline;
+    QPointer<ChannelListModel> channelListModel;
+    QHash<QString,QPointer<MessageListModel> > messageListModels;
+    ContentCache contentCache;
 
     QNetworkAccessManager::NetworkAccessibility networkAccessible;
+    QSet<QString> loadedChannelIds;
+
+    // Message loads by request key, so that equal loads share one request
+    struct PendingLoad {
+        PendingLoad() : requestId(0) {}
+
+        QString channelId;
+        int requestId;
+    };
+    QHash<QString,PendingLoad> pendingLoads;
+
+    QHash<QString,EventHandler> eventHandlers;
+    QHash<QString,EventStats> eventStats;
+
+    // Ids changed since the last event loop pass, see emitPendingUpdates()
+    QSet<QString> pendingChannelIds;
+    QSet<QString> pendingUserIds;
 };
 
 #endif // SLACKCLIENT_H
@@ -27,6 +27,14 @@ void SlackConfig::setUserId(QString userId) {
     currentUserId = userId;
 }
 
+int SlackConfig::channelMessageLimit() {
+    return settings.value("storage/channelMessageLimit", 500).toInt();
+}
+
+qint64 SlackConfig::streamMessageSizeLimit() {
+    return settings.value("stream/messageSizeLimit", 16 * 1024 * 1024).toLongLong();
+}
+
 void SlackConfig::clearWebViewCache() {
     QStringList dataPaths = QStandardPaths::standardLocations(QStandardPaths::DataLocation);
 
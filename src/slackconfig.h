@@ -15,6 +15,8 @@ public:
     void clearAccessToken();
     QString userId();
     void setUserId(QString userId);
+    int channelMessageLimit();
+    qint64 streamMessageSizeLimit();
 
     static void clearWebViewCache();
 
@@ -9,7 +9,7 @@ SlackStream::SlackStream(QObject *parent) : QObject(parent), isConnected(false),
 
     connect(webSocket, SIGNAL(connected()), this, SLOT(handleListerStart()));
     connect(webSocket, SIGNAL(disconnected()), this, SLOT(handleListerEnd()));
-    connect(webSocket, SIGNAL(frameReceived(QString)), this, SLOT(handleMessage(QString)));
+    connect(webSocket, SIGNAL(textFrameReceived(QByteArray)), this, SLOT(handleMessage(QByteArray)));
     connect(webSocket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(handleError(QAbstractSocket::SocketError)));
     connect(checkTimer, SIGNAL(timeout()), this, SLOT(checkConnection()));
 }
@@ -22,6 +22,10 @@ SlackStream::~SlackStream() {
     }
 }
 
+void SlackStream::setMessageSizeLimit(qint64 limit) {
+    webSocket->setMaxMessageSize(limit);
+}
+
 void SlackStream::disconnectFromHost() {
     qDebug() << "Disconnecting socket";
     webSocket->disconnectFromHost();
@@ -47,7 +51,7 @@ void SlackStream::send(QJsonObject message) {
     QByteArray data = document.toJson(QJsonDocument::Compact);
     qDebug() << "Send" << data;
 
-    webSocket->write(QString(data));
+    webSocket->writeText(data);
 }
 
 void SlackStream::checkConnection() {
@@ -78,11 +82,11 @@ void SlackStream::handleListerEnd() {
     emit disconnected();
 }
 
-void SlackStream::handleMessage(QString message) {
+void SlackStream::handleMessage(QByteArray message) {
     qDebug() << "Got message" << message;
 
     QJsonParseError error;
-    QJsonDocument document = QJsonDocument::fromJson(message.toUtf8(), &error);
+    QJsonDocument document = QJsonDocument::fromJson(message, &error);
     if (error.error != QJsonParseError::NoError) {
         qDebug() << "Failed to parse message" << message;
         return;
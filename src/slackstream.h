@@ -24,13 +24,14 @@ signals:
     void messageReceived(QJsonObject message);
 
 public slots:
+    void setMessageSizeLimit(qint64 limit);
     void disconnectFromHost();
     void listen(QUrl url);
     void send(QJsonObject message);
     void checkConnection();
     void handleListerStart();
     void handleListerEnd();
-    void handleMessage(QString message);
+    void handleMessage(QByteArray message);
     void handleError(QAbstractSocket::SocketError error);
 
 private:
@@ -0,0 +1,80 @@
+#include "slacktimestamp.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+
+static const int fractionDigits = 6;
+static const int maxSecondsDigits = 12;
+static const int maxCachedDays = 1024;
+
+// Messages are parsed on worker threads, so the label cache is shared
+static QMutex dayLabelMutex;
+static QHash<qint64,QString> dayLabels;
+
+SlackTimestamp SlackTimestamp::parse(const QString &ts) {
+    SlackTimestamp result;
+    const QChar *c = ts.constData();
+    const QChar *end = c + ts.size();
+
+    qint64 secs = 0;
+    int digits = 0;
+    for (; c != end && c->unicode() != '.'; ++c, ++digits) {
+        ushort d = c->unicode() - '0';
+        if (d > 9 || digits == maxSecondsDigits) {
+            return result;
+        }
+        secs = secs * 10 + d;
+    }
+    if (digits == 0) {
+        return result;
+    }
+
+    qint32 micros = 0;
+    digits = 0;
+    if (c != end) {
+        for (++c; c != end; ++c, ++digits) {
+            ushort d = c->unicode() - '0';
+            if (d > 9 || digits == fractionDigits) {
+                return result;
+            }
+            micros = micros * 10 + d;
+        }
+        // A shorter fraction is still a decimal: "1.5" is 1.500000
+        for (; digits < fractionDigits; digits++) {
+            micros *= 10;
+        }
+    }
+
+    result.secs = secs;
+    result.micros = micros;
+    result.valid = true;
+    return result;
+}
+
+QString SlackTimestamp::dayLabel(const QDate &date) {
+    qint64 day = date.toJulianDay();
+
+    QMutexLocker locker(&dayLabelMutex);
+
+    QHash<qint64,QString>::const_iterator i = dayLabels.constFind(day);
+    if (i != dayLabels.constEnd()) {
+        return *i;
+    }
+
+    if (dayLabels.size() >= maxCachedDays) {
+        dayLabels.clear();
+    }
+
+    QString label = date.toString("MMMM d, yyyy");
+    dayLabels.insert(day, label);
+    return label;
+}
+
+QDataStream &operator<<(QDataStream &out, const SlackTimestamp &ts) {
+    return out << ts.secs << ts.micros << ts.valid;
+}
+
+QDataStream &operator>>(QDataStream &in, SlackTimestamp &ts) {
+    return in >> ts.secs >> ts.micros >> ts.valid;
+}
@@ -0,0 +1,48 @@
+#ifndef SLACKTIMESTAMP_H
+#define SLACKTIMESTAMP_H
+
+#include <QString>
+#include <QDate>
+#include <QDataStream>
+
+// Slack "ts" value such as "1503435956.000247": whole seconds since the
+// epoch and a six digit fraction, kept as integers so that timestamps sort
+// exactly and convert to time without building intermediate strings. The
+// fraction is microseconds by format, though Slack uses it to keep
+// messages within the same second unique and ordered.
+class SlackTimestamp
+{
+public:
+    SlackTimestamp() : secs(0), micros(0), valid(false) {}
+
+    static SlackTimestamp parse(const QString &ts);
+
+    bool isValid() const { return valid; }
+    qint64 seconds() const { return secs; }
+    qint32 microseconds() const { return micros; }
+    qint64 toMSecsSinceEpoch() const { return secs * 1000 + micros / 1000; }
+
+    // Date as shown above the messages of that day, e.g. "August 22, 2017";
+    // labels are cached per day
+    static QString dayLabel(const QDate &date);
+
+    bool operator<(const SlackTimestamp &other) const {
+        return secs < other.secs || (secs == other.secs && micros < other.micros);
+    }
+    bool operator==(const SlackTimestamp &other) const {
+        return secs == other.secs && micros == other.micros;
+    }
+
+private:
+    qint64 secs;
+    qint32 micros;
+    bool valid;
+
+    friend QDataStream &operator<<(QDataStream &out, const SlackTimestamp &ts);
+    friend QDataStream &operator>>(QDataStream &in, SlackTimestamp &ts);
+};
+
+QDataStream &operator<<(QDataStream &out, const SlackTimestamp &ts);
+QDataStream &operator>>(QDataStream &in, SlackTimestamp &ts);
+
+#endif // SLACKTIMESTAMP_H
@@ -1,65 +1,725 @@
 #include "storage.h"
 
+#include <algorithm>
+
 #include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QJsonDocument>
+
+static const quint32 snapshotMagic = 0x534c4653;
+static const quint32 snapshotVersion = 4;
+static const int snapshotMessageCount = 20;
+
+QMutex Storage::idPoolMutex;
+QMutex Storage::snapshotMutex;
+QReadWriteLock Storage::indexLock;
+QSet<QString> Storage::idPool = QSet<QString>();
+QHash<QString,User> Storage::userIndex = QHash<QString,User>();
+QHash<QString,Channel> Storage::channelIndex = QHash<QString,Channel>();
+QHash<QString,QString> Storage::imIndex = QHash<QString,QString>();
+QHash<QString,MessageBuffer> Storage::channelMessageIndex = QHash<QString,MessageBuffer>();
+int Storage::messageLimit = 500;
+quint64 Storage::generation = 0;
+QHash<QString,quint64> Storage::nameGenerations = QHash<QString,quint64>();
+
+static qint64 variantSize(const QVariant &value) {
+    switch (value.type()) {
+    case QVariant::String:
+        return value.toString().size() * sizeof(QChar);
+    case QVariant::List: {
+        qint64 size = 0;
+        foreach (const QVariant &item, value.toList()) {
+            size += variantSize(item);
+        }
+        return size;
+    }
+    case QVariant::Map: {
+        qint64 size = 0;
+        QVariantMap map = value.toMap();
+        for (QVariantMap::const_iterator i = map.constBegin(); i != map.constEnd(); ++i) {
+            size += i.key().size() * sizeof(QChar) + variantSize(i.value());
+        }
+        return size;
+    }
+    default:
+        return sizeof(QVariant);
+    }
+}
+
+static QDataStream &operator<<(QDataStream &out, const User &user) {
+    return out << user.id << user.name << user.presence;
+}
+
+static QDataStream &operator>>(QDataStream &in, User &user) {
+    in >> user.id >> user.name >> user.presence;
+    user.id = Storage::intern(user.id);
+    return in;
+}
+
+static QDataStream &operator<<(QDataStream &out, const Channel &channel) {
+    return out << channel.id << channel.type << channel.category << channel.name << channel.presence
+               << channel.isOpen << channel.lastRead << qint32(channel.unreadCount) << channel.userId;
+}
+
+static QDataStream &operator>>(QDataStream &in, Channel &channel) {
+    qint32 unreadCount;
+    in >> channel.id >> channel.type >> channel.category >> channel.name >> channel.presence
+       >> channel.isOpen >> channel.lastRead >> unreadCount >> channel.userId;
+    channel.unreadCount = unreadCount;
+    return in;
+}
+
+static QDataStream &operator<<(QDataStream &out, const Message &message) {
+    QByteArray source = message.isFormatted() ? QByteArray() : QJsonDocument(message.source).toJson(QJsonDocument::Compact);
+    return out << message.type << message.time << message.timegroup << message.timestamp << message.channel
+               << message.user << message.ts
+               << message.content << message.attachments << message.images << source;
+}
+
+static QDataStream &operator>>(QDataStream &in, Message &message) {
+    QByteArray source;
+    in >> message.type >> message.time >> message.timegroup >> message.timestamp >> message.channel
+       >> message.user >> message.ts
+       >> message.content >> message.attachments >> message.images >> source;
+    message.channel = Storage::intern(message.channel);
+    if (!source.isEmpty()) {
+        message.source = QJsonDocument::fromJson(source).object();
+    }
+    return in;
+}
+
+QVariantMap User::toMap() const {
+    QVariantMap data;
+    data.insert("id", QVariant(id));
+    data.insert("name", QVariant(name));
+    data.insert("presence", QVariant(presence));
+    return data;
+}
+
+QVariantMap Channel::toMap() const {
+    QVariantMap data;
+    if (!isValid()) {
+        return data;
+    }
+
+    data.insert("id", QVariant(id));
+    data.insert("type", QVariant(type));
+    data.insert("category", QVariant(category));
+    data.insert("name", QVariant(name));
+    data.insert("presence", QVariant(presence));
+    data.insert("isOpen", QVariant(isOpen));
+    data.insert("lastRead", QVariant(lastRead));
+    data.insert("unreadCount", QVariant(unreadCount));
+    data.insert("userId", userId.isEmpty() ? QVariant() : QVariant(userId));
+    return data;
+}
+
+QVariantMap Message::toMap() const {
+    QVariantMap data;
+    data.insert("type", QVariant(type));
+    data.insert("time", QVariant::fromValue(time));
+    data.insert("timegroup", QVariant(timegroup));
+    data.insert("timestamp", QVariant(timestamp));
+    data.insert("channel", channel.isEmpty() ? QVariant() : QVariant(channel));
+    data.insert("user", user.toMap());
+    data.insert("attachments", attachments);
+    data.insert("images", images);
+    data.insert("content", QVariant(content));
+    return data;
+}
+
+qint64 Message::byteSize() const {
+    qint64 size = sizeof(Message);
+    size += (type.size() + timegroup.size() + timestamp.size() + content.size()) * sizeof(QChar);
+    size += (user.name.size() + user.presence.size()) * sizeof(QChar);
+    size += variantSize(attachments);
+    size += variantSize(images);
+    if (!isFormatted()) {
+        size += source.value("text").toString().size() * sizeof(QChar);
+    }
+    return size;
+}
+
+int countBefore(const QList<Message> &messages, const Message &message) {
+    QList<Message>::const_iterator i = std::lower_bound(messages.constBegin(), messages.constEnd(), message,
+                                                        [](const Message &a, const Message &b) -> bool {
+        return a.isBefore(b);
+    });
+    return i - messages.constBegin();
+}
+
+MessageBuffer::MessageBuffer(int capacity) : cache(capacity), bytes(0) {
+}
+
+int MessageBuffer::capacity() const {
+    return cache.capacity();
+}
+
+void MessageBuffer::setCapacity(int capacity) {
+    if (capacity == cache.capacity()) {
+        return;
+    }
+
+    QList<Message> existing = messages();
+    cache.clear();
+    cache.setCapacity(capacity);
+    bytes = 0;
+
+    for (int i = qMax(0, existing.size() - capacity); i < existing.size(); i++) {
+        append(existing.at(i));
+    }
+}
+
+void MessageBuffer::append(const Message &message) {
+    if (cache.capacity() == 0) {
+        return;
+    }
+
+    if (cache.isFull()) {
+        bytes -= cache.first().byteSize();
+    }
+
+    cache.append(message);
+    bytes += message.byteSize();
+
+    if (!cache.areIndexesValid()) {
+        cache.normalizeIndexes();
+    }
+}
+
+void MessageBuffer::prepend(const QList<Message> &messages) {
+    int count = cache.isEmpty() ? messages.size() : countBefore(messages, cache.first());
+
+    for (int i = count - 1; i >= 0 && cache.available() > 0; i--) {
+        cache.prepend(messages.at(i));
+        bytes += messages.at(i).byteSize();
+    }
+
+    if (!cache.areIndexesValid()) {
+        cache.normalizeIndexes();
+    }
+}
+
+// Returns false if the messages did not all follow the buffered ones and
+// the buffer had to be rebuilt in order
+bool MessageBuffer::merge(const QList<Message> &messages) {
+    if (cache.isEmpty() || messages.isEmpty() || cache.last().isBefore(messages.first())) {
+        foreach (const Message &message, messages) {
+            append(message);
+        }
+        return true;
+    }
+
+    QList<Message> existing = this->messages();
+    QList<Message> merged;
+    merged.reserve(existing.size() + messages.size());
+
+    int i = 0;
+    int j = 0;
+    while (i < existing.size() || j < messages.size()) {
+        if (j == messages.size() || (i < existing.size() && existing.at(i).isBefore(messages.at(j)))) {
+            merged.append(existing.at(i++));
+        }
+        else if (i == existing.size() || messages.at(j).isBefore(existing.at(i))) {
+            merged.append(messages.at(j++));
+        }
+        else {
+            // Same timestamp, already stored
+            merged.append(existing.at(i++));
+            j++;
+        }
+    }
+
+    clear();
+    prepend(merged);
+    return false;
+}
+
+// Returns false if no message with the same timestamp is buffered
+bool MessageBuffer::update(const Message &message) {
+    int low = cache.firstIndex();
+    int high = cache.lastIndex();
+
+    while (low <= high) {
+        int middle = low + (high - low) / 2;
+        const Message &stored = cache.at(middle);
+
+        if (stored.isBefore(message)) {
+            low = middle + 1;
+        }
+        else if (message.isBefore(stored)) {
+            high = middle - 1;
+        }
+        else {
+            bytes += message.byteSize() - stored.byteSize();
+            cache[middle] = message;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool MessageBuffer::isEmpty() const {
+    return cache.isEmpty();
+}
+
+Message MessageBuffer::last() const {
+    return cache.isEmpty() ? Message() : cache.last();
+}
+
+void MessageBuffer::clear() {
+    cache.clear();
+    bytes = 0;
+}
+
+QList<Message> MessageBuffer::messages() const {
+    QList<Message> list;
+    list.reserve(cache.count());
+
+    for (int i = cache.firstIndex(); i <= cache.lastIndex(); i++) {
+        list.append(cache.at(i));
+    }
+    return list;
+}
+
+MessageStats MessageBuffer::stats() const {
+    MessageStats stats;
+    stats.messages = cache.count();
+    stats.bytes = bytes;
+    return stats;
+}
+
+QString Storage::intern(const QString &id) {
+    QMutexLocker locker(&idPoolMutex);
+
+    QSet<QString>::const_iterator i = idPool.constFind(id);
+    if (i != idPool.constEnd()) {
+        return *i;
+    }
+
+    idPool.insert(id);
+    return id;
+}
+
+void Storage::saveUser(const User &user) {
+    if (!user.isValid()) {
+        return;
+    }
+
+    User data = user;
+    data.id = intern(user.id);
+
+    QWriteLocker locker(&indexLock);
+    QHash<QString,User>::iterator i = userIndex.find(data.id);
+    if (i == userIndex.end() || i.value().name != data.name) {
+        nameChanged(data.id);
+    }
+    userIndex.insert(data.id, data);
+}
+
+User Storage::user(const QString &id) {
+    QReadLocker locker(&indexLock);
+    return userIndex.value(id);
+}
 
-QVariantMap Storage::userMap = QVariantMap();
-QVariantMap Storage::channelMap = QVariantMap();
-QVariantMap Storage::channelMessageMap = QVariantMap();
+QHash<QString,User> Storage::users() {
+    QReadLocker locker(&indexLock);
+    return userIndex;
+}
+
+void Storage::saveChannel(const Channel &channel) {
+    if (!channel.isValid()) {
+        return;
+    }
+
+    Channel data = channel;
+    data.id = intern(channel.id);
+    if (!data.userId.isEmpty()) {
+        data.userId = intern(channel.userId);
+    }
+
+    QWriteLocker locker(&indexLock);
+    QHash<QString,Channel>::iterator i = channelIndex.find(data.id);
+    if (i == channelIndex.end() || i.value().name != data.name) {
+        nameChanged(data.id);
+    }
+    if (i != channelIndex.end()) {
+        unindexIm(i.value());
+    }
+    indexIm(data);
+    channelIndex.insert(data.id, data);
+}
+
+QString Storage::imChannelId(const QString &userId) {
+    QReadLocker locker(&indexLock);
+    return imIndex.value(userId);
+}
+
+void Storage::savePresence(const QStringList &userIds, const QString &presence,
+                           QStringList &changedUserIds, QStringList &changedChannelIds) {
+    QWriteLocker locker(&indexLock);
+
+    foreach (const QString &userId, userIds) {
+        QHash<QString,User>::iterator user = userIndex.find(userId);
+        if (user != userIndex.end() && user.value().presence != presence) {
+            user.value().presence = presence;
+            changedUserIds << user.key();
+        }
+
+        QHash<QString,QString>::const_iterator im = imIndex.constFind(userId);
+        if (im == imIndex.constEnd()) {
+            continue;
+        }
+
+        QHash<QString,Channel>::iterator channel = channelIndex.find(im.value());
+        if (channel != channelIndex.end() && channel.value().presence != presence) {
+            channel.value().presence = presence;
+            changedChannelIds << channel.key();
+        }
+    }
+}
+
+// Called with indexLock locked for writing
+void Storage::indexIm(const Channel &channel) {
+    if (channel.type == "im" && !channel.userId.isEmpty()) {
+        imIndex.insert(channel.userId, channel.id);
+    }
+}
+
+// Called with indexLock locked for writing
+void Storage::unindexIm(const Channel &channel) {
+    QHash<QString,QString>::iterator i = imIndex.find(channel.userId);
+    if (i != imIndex.end() && i.value() == channel.id) {
+        imIndex.erase(i);
+    }
+}
+
+Channel Storage::channel(const QString &id) {
+    QReadLocker locker(&indexLock);
+    return channelIndex.value(id);
+}
+
+QHash<QString,Channel> Storage::channels() {
+    QReadLocker locker(&indexLock);
+    return channelIndex;
+}
 
-void Storage::saveUser(QVariantMap user) {
-    userMap.insert(user.value("id").toString(), user);
+QList<Message> Storage::channelMessages(const QString &channelId) {
+    return channelMessageIndex.value(channelId).messages();
 }
 
-QVariantMap Storage::user(QVariant id) {
-    return userMap.value(id.toString()).toMap();
+bool Storage::channelMessagesExist(const QString &channelId) {
+    return channelMessageIndex.contains(channelId);
 }
 
-QVariantList Storage::users() {
-    return userMap.values();
+MessageBuffer &Storage::channelBuffer(const QString &channelId) {
+    QHash<QString,MessageBuffer>::iterator i = channelMessageIndex.find(channelId);
+    if (i == channelMessageIndex.end()) {
+        i = channelMessageIndex.insert(intern(channelId), MessageBuffer(messageLimit));
+    }
+    return i.value();
 }
 
-void Storage::saveChannel(QVariantMap channel) {
-    channelMap.insert(channel.value("id").toString(), channel);
+void Storage::setChannelMessages(const QString &channelId, const QList<Message> &messages) {
+    MessageBuffer &buffer = channelBuffer(channelId);
+    buffer.clear();
+    buffer.prepend(messages);
 }
 
-QVariantMap Storage::channel(QVariant id) {
-    return channelMap.value(id.toString()).toMap();
+void Storage::prependChannelMessages(const QString &channelId, const QList<Message> &messages) {
+    channelBuffer(channelId).prepend(messages);
 }
 
-QVariantList Storage::channels() {
-    return channelMap.values();
+void Storage::appendChannelMessage(const QString &channelId, const Message &message) {
+    channelBuffer(channelId).append(message);
 }
 
-QVariantList Storage::channelMessages(QVariant channelId) {
-    return channelMessageMap.value(channelId.toString()).toList();
+bool Storage::mergeChannelMessages(const QString &channelId, const QList<Message> &messages) {
+    return channelBuffer(channelId).merge(messages);
 }
 
-bool Storage::channelMessagesExist(QVariant channelId) {
-    return channelMessageMap.contains(channelId.toString());
+void Storage::updateChannelMessage(const QString &channelId, const Message &message) {
+    QHash<QString,MessageBuffer>::iterator i = channelMessageIndex.find(channelId);
+    if (i != channelMessageIndex.end()) {
+        i.value().update(message);
+    }
 }
 
-void Storage::setChannelMessages(QVariant channelId, QVariantList messages) {
-    channelMessageMap.insert(channelId.toString(), messages);
+Message Storage::lastChannelMessage(const QString &channelId) {
+    QHash<QString,MessageBuffer>::const_iterator i = channelMessageIndex.constFind(channelId);
+    return i == channelMessageIndex.constEnd() ? Message() : i.value().last();
 }
 
-void Storage::prependChannelMessages(QVariant channelId, QVariantList messages) {
-    QVariantList existing = channelMessages(channelId);
-    messages.append(existing);
-    setChannelMessages(channelId, messages);
+QStringList Storage::cachedChannelIds() {
+    return channelMessageIndex.keys();
 }
 
-void Storage::appendChannelMessage(QVariant channelId, QVariantMap message) {
-    QVariantList messages = channelMessages(channelId);
-    messages.append(message);
-    setChannelMessages(channelId, messages);
+void Storage::removeChannelMessages(const QString &channelId) {
+    channelMessageIndex.remove(channelId);
 }
 
 void Storage::clearChannelMessages() {
-    channelMessageMap.clear();
+    channelMessageIndex.clear();
+}
+
+int Storage::channelMessageLimit() {
+    return messageLimit;
+}
+
+void Storage::setChannelMessageLimit(int limit) {
+    messageLimit = qMax(1, limit);
+
+    for (QHash<QString,MessageBuffer>::iterator i = channelMessageIndex.begin(); i != channelMessageIndex.end(); ++i) {
+        i.value().setCapacity(messageLimit);
+    }
+}
+
+QHash<QString,MessageStats> Storage::channelMessageStats() {
+    QHash<QString,MessageStats> stats;
+
+    for (QHash<QString,MessageBuffer>::const_iterator i = channelMessageIndex.constBegin(); i != channelMessageIndex.constEnd(); ++i) {
+        stats.insert(i.key(), i.value().stats());
+    }
+    return stats;
+}
+
+quint64 Storage::directoryGeneration() {
+    QReadLocker locker(&indexLock);
+    return generation;
+}
+
+quint64 Storage::nameGeneration(const QString &id) {
+    QReadLocker locker(&indexLock);
+    return nameGenerations.value(id);
+}
+
+// Called with indexLock locked for writing
+void Storage::nameChanged(const QString &id) {
+    generation++;
+    nameGenerations.insert(id, generation);
+}
+
+void Storage::removeStaleUsers(const QSet<QString> &currentIds) {
+    QWriteLocker locker(&indexLock);
+    QHash<QString,User>::iterator i = userIndex.begin();
+    while (i != userIndex.end()) {
+        if (currentIds.contains(i.key())) {
+            ++i;
+        }
+        else {
+            nameChanged(i.key());
+            i = userIndex.erase(i);
+        }
+    }
+}
+
+void Storage::removeStaleChannels(const QSet<QString> &currentIds) {
+    QWriteLocker locker(&indexLock);
+    QHash<QString,Channel>::iterator i = channelIndex.begin();
+    while (i != channelIndex.end()) {
+        if (currentIds.contains(i.key())) {
+            ++i;
+        }
+        else {
+            channelMessageIndex.remove(i.key());
+            nameChanged(i.key());
+            unindexIm(i.value());
+            i = channelIndex.erase(i);
+        }
+    }
+}
+
+QString Storage::snapshotPath() {
+    QString dataPath = QStandardPaths::writableLocation(QStandardPaths::DataLocation);
+    if (dataPath.isEmpty()) {
+        return QString();
+    }
+
+    return QDir(dataPath).filePath("workspace.dat");
+}
+
+// Called on the main thread, as it reads channel messages
+Snapshot Storage::takeSnapshot() {
+    Snapshot snapshot;
+    snapshot.users = users();
+    snapshot.channels = channels();
+
+    for (QHash<QString,MessageBuffer>::const_iterator i = channelMessageIndex.constBegin(); i != channelMessageIndex.constEnd(); ++i) {
+        QList<Message> messages = i.value().messages();
+        snapshot.messages.insert(i.key(), messages.mid(qMax(0, messages.size() - snapshotMessageCount)));
+    }
+    return snapshot;
+}
+
+bool Storage::saveSnapshot() {
+    return writeSnapshot(takeSnapshot());
+}
+
+bool Storage::writeSnapshot(const Snapshot &snapshot) {
+    QString path = snapshotPath();
+    if (path.isEmpty() || snapshot.channels.isEmpty()) {
+        return false;
+    }
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    stream << quint32(snapshot.users.size());
+    foreach (const User &user, snapshot.users) {
+        stream << user;
+    }
+
+    stream << quint32(snapshot.channels.size());
+    foreach (const Channel &channel, snapshot.channels) {
+        stream << channel;
+    }
+
+    stream << quint32(snapshot.messages.size());
+    for (QHash<QString,QList<Message> >::const_iterator i = snapshot.messages.constBegin(); i != snapshot.messages.constEnd(); ++i) {
+        stream << i.key() << quint32(i.value().size());
+        foreach (const Message &message, i.value()) {
+            stream << message;
+        }
+    }
+
+    QByteArray compressed = qCompress(data);
+
+    // Written from a worker while running and on the main thread at exit
+    QMutexLocker locker(&snapshotMutex);
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Snapshot not writable" << path;
+        return false;
+    }
+
+    QDataStream header(&file);
+    header.setVersion(QDataStream::Qt_5_0);
+    header << snapshotMagic << snapshotVersion << compressed;
+
+    if (!file.commit()) {
+        qWarning() << "Snapshot write failed" << path;
+        return false;
+    }
+
+    qDebug() << "Snapshot saved" << snapshot.users.size() << snapshot.channels.size() << data.size();
+    return true;
+}
+
+bool Storage::loadSnapshot() {
+    QString path = snapshotPath();
+    if (path.isEmpty()) {
+        return false;
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    quint32 magic;
+    quint32 version;
+    QByteArray compressed;
+    QDataStream header(&file);
+    header.setVersion(QDataStream::Qt_5_0);
+    header >> magic >> version >> compressed;
+
+    if (header.status() != QDataStream::Ok || magic != snapshotMagic || version != snapshotVersion) {
+        qDebug() << "Snapshot ignored" << path;
+        return false;
+    }
+
+    QByteArray data = qUncompress(compressed);
+    QDataStream stream(&data, QIODevice::ReadOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    QHash<QString,User> users;
+    QHash<QString,Channel> channels;
+    QHash<QString,MessageBuffer> messages;
+
+    quint32 count;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        User user;
+        stream >> user;
+        users.insert(user.id, user);
+    }
+
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        Channel channel;
+        stream >> channel;
+        channel.id = intern(channel.id);
+        if (!channel.userId.isEmpty()) {
+            channel.userId = intern(channel.userId);
+        }
+        channels.insert(channel.id, channel);
+    }
+
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        QString channelId;
+        quint32 messageCount;
+        stream >> channelId >> messageCount;
+
+        QList<Message> channelMessages;
+        for (quint32 j = 0; j < messageCount && stream.status() == QDataStream::Ok; j++) {
+            Message message;
+            stream >> message;
+            channelMessages.append(message);
+        }
+
+        MessageBuffer buffer(messageLimit);
+        buffer.prepend(channelMessages);
+        messages.insert(intern(channelId), buffer);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Snapshot corrupted" << path;
+        return false;
+    }
+
+    QWriteLocker locker(&indexLock);
+    userIndex = users;
+    channelIndex = channels;
+    imIndex.clear();
+    foreach (const Channel &channel, channels) {
+        indexIm(channel);
+    }
+    foreach (const QString &id, users.keys() + channels.keys()) {
+        nameChanged(id);
+    }
+    channelMessageIndex = messages;
+
+    qDebug() << "Snapshot loaded" << userIndex.size() << channelIndex.size();
+    return true;
+}
+
+void Storage::removeSnapshot() {
+    QString path = snapshotPath();
+    if (!path.isEmpty()) {
+        QFile::remove(path);
+    }
 }
 
 void Storage::clear() {
-    userMap.clear();
-    channelMap.clear();
-    channelMessageMap.clear();
+    QWriteLocker locker(&indexLock);
+    foreach (const QString &id, userIndex.keys() + channelIndex.keys()) {
+        nameChanged(id);
+    }
+    userIndex.clear();
+    channelIndex.clear();
+    imIndex.clear();
+    channelMessageIndex.clear();
+
+    QMutexLocker poolLocker(&idPoolMutex);
+    idPool.clear();
 }
@@ -2,26 +2,183 @@
 #define STORAGE_H
 
 #include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QStringList>
+#include <QContiguousCache>
+#include <QDateTime>
+#include <QVariant>
+#include <QJsonObject>
+#include <QMutex>
+#include <QReadWriteLock>
 
+#include "slacktimestamp.h"
+
+struct User
+{
+    QString id;
+    QString name;
+    QString presence;
+
+    bool isValid() const { return !id.isEmpty(); }
+    QVariantMap toMap() const;
+};
+
+struct Channel
+{
+    Channel() : isOpen(false), unreadCount(0) {}
+
+    QString id;
+    QString type;
+    QString category;
+    QString name;
+    QString presence;
+    bool isOpen;
+    QString lastRead;
+    int unreadCount;
+    QString userId;
+
+    bool isValid() const { return !id.isEmpty(); }
+    QVariantMap toMap() const;
+};
+
+struct Message
+{
+    QString type;
+    QDateTime time;
+    QString timegroup;
+    QString timestamp;
+    QString channel;
+    User user;
+
+    // Parsed timestamp, the sort key of messages within a channel
+    SlackTimestamp ts;
+    QString content;
+    QVariantList attachments;
+    QVariantList images;
+
+    // Raw message data, kept until content, attachments and images have
+    // been formatted from it
+    QJsonObject source;
+
+    bool isFormatted() const { return source.isEmpty(); }
+    bool isBefore(const Message &other) const {
+        return ts < other.ts;
+    }
+    QVariantMap toMap() const;
+    qint64 byteSize() const;
+};
+
+struct MessageStats
+{
+    MessageStats() : messages(0), bytes(0) {}
+
+    int messages;
+    qint64 bytes;
+};
+
+// What a snapshot file holds: users, channels and the recent messages of
+// each channel. Taken on the main thread, it can be written from any.
+struct Snapshot
+{
+    QHash<QString,User> users;
+    QHash<QString,Channel> channels;
+    QHash<QString,QList<Message> > messages;
+};
+
+// Number of messages at the start of a sorted list that are older than
+// the given message, i.e. how much of a history page precedes it
+int countBefore(const QList<Message> &messages, const Message &message);
+
+// Bounded ring buffer of channel messages in time order. Appending a
+// realtime message or prepending a history page never copies the stored
+// messages; when the buffer is full the oldest message is dropped on
+// append and older history is not kept on prepend. A prepended page must
+// be sorted; messages in it that are not older than the buffered ones
+// are already stored and are skipped. Merging adds the messages of a
+// sorted page that are missing, such as those received while offline.
+// Updating replaces the stored message with the same timestamp.
+class MessageBuffer
+{
+public:
+    explicit MessageBuffer(int capacity = 0);
+
+    int capacity() const;
+    void setCapacity(int capacity);
+
+    void append(const Message &message);
+    void prepend(const QList<Message> &messages);
+    bool merge(const QList<Message> &messages);
+    bool update(const Message &message);
+    void clear();
+
+    bool isEmpty() const;
+    Message last() const;
+
+    QList<Message> messages() const;
+    MessageStats stats() const;
+
+private:
+    QContiguousCache<Message> cache;
+    qint64 bytes;
+};
+
+// User and channel records may be read and saved from worker threads;
+// channel messages are only accessed from the main thread.
+//
+// The directory generation grows whenever a user or channel is added,
+// renamed or removed, and nameGeneration() tells when that last happened
+// to a given id, so formatted content can tell if a name it shows is stale.
+//
+// IM channels are also indexed by the user they are with, so presence
+// changes reach the IM of a user without scanning all channels.
 class Storage : public QObject
 {
     Q_OBJECT
 public:
-    static QVariantMap user(QVariant id);
-    static QVariantList users();
-    static void saveUser(QVariantMap user);
-
-    static QVariantMap channel(QVariant id);
-    static QVariantList channels();
-    static void saveChannel(QVariantMap channel);
-
-    static QVariantList channelMessages(QVariant channelId);
-    static bool channelMessagesExist(QVariant channelId);
-    static void setChannelMessages(QVariant channelId, QVariantList messages);
-    static void prependChannelMessages(QVariant channelId, QVariantList messages);
-    static void appendChannelMessage(QVariant channelId, QVariantMap message);
+    static QString intern(const QString &id);
+
+    static User user(const QString &id);
+    static QHash<QString,User> users();
+    static void saveUser(const User &user);
+
+    static Channel channel(const QString &id);
+    static QHash<QString,Channel> channels();
+    static void saveChannel(const Channel &channel);
+    static QString imChannelId(const QString &userId);
+
+    static void savePresence(const QStringList &userIds, const QString &presence,
+                             QStringList &changedUserIds, QStringList &changedChannelIds);
+
+    static QList<Message> channelMessages(const QString &channelId);
+    static bool channelMessagesExist(const QString &channelId);
+    static void setChannelMessages(const QString &channelId, const QList<Message> &messages);
+    static void prependChannelMessages(const QString &channelId, const QList<Message> &messages);
+    static void appendChannelMessage(const QString &channelId, const Message &message);
+    static bool mergeChannelMessages(const QString &channelId, const QList<Message> &messages);
+    static void updateChannelMessage(const QString &channelId, const Message &message);
+    static Message lastChannelMessage(const QString &channelId);
+    static QStringList cachedChannelIds();
+    static void removeChannelMessages(const QString &channelId);
     static void clearChannelMessages();
 
+    static int channelMessageLimit();
+    static void setChannelMessageLimit(int limit);
+    static QHash<QString,MessageStats> channelMessageStats();
+
+    static quint64 directoryGeneration();
+    static quint64 nameGeneration(const QString &id);
+
+    static void removeStaleUsers(const QSet<QString> &currentIds);
+    static void removeStaleChannels(const QSet<QString> &currentIds);
+
+    static Snapshot takeSnapshot();
+    static bool writeSnapshot(const Snapshot &snapshot);
+    static bool saveSnapshot();
+    static bool loadSnapshot();
+    static void removeSnapshot();
+
     static void clear();
 
 signals:
@@ -29,9 +186,23 @@ signals:
 public slots:
 
 private:
-    static QVariantMap userMap;
-    static QVariantMap channelMap;
-    static QVariantMap channelMessageMap;
+    static QMutex idPoolMutex;
+    static QMutex snapshotMutex;
+    static QReadWriteLock indexLock;
+    static QSet<QString> idPool;
+    static QHash<QString,User> userIndex;
+    static QHash<QString,Channel> channelIndex;
+    static QHash<QString,QString> imIndex;
+    static QHash<QString,MessageBuffer> channelMessageIndex;
+    static int messageLimit;
+    static quint64 generation;
+    static QHash<QString,quint64> nameGenerations;
+
+    static MessageBuffer &channelBuffer(const QString &channelId);
+    static void nameChanged(const QString &id);
+    static void indexIm(const Channel &channel);
+    static void unindexIm(const Channel &channel);
+    static QString snapshotPath();
 };
 
 #endif // STORAGE_H
@@ -0,0 +1,46 @@
+#include "workerpipeline.h"
+
+WorkerPipeline::WorkerPipeline(QObject *parent) : QObject(parent) {
+}
+
+void WorkerPipeline::post(const QString &key, std::function<void()> done) {
+    if (!jobs.contains(key)) {
+        done();
+        return;
+    }
+
+    Job job;
+    job.watcher = 0;
+    job.deliver = done;
+    jobs[key].enqueue(job);
+}
+
+// Blocks until no work is running, dropping results not yet delivered.
+// Needed before the owner of the work functions goes away.
+void WorkerPipeline::waitForDone() {
+    foreach (const QQueue<Job> &queue, jobs) {
+        foreach (const Job &job, queue) {
+            if (job.watcher) {
+                job.watcher->disconnect();
+                job.watcher->waitForFinished();
+                job.watcher->deleteLater();
+            }
+        }
+    }
+    jobs.clear();
+}
+
+void WorkerPipeline::flush(const QString &key) {
+    while (jobs.contains(key) && !jobs[key].isEmpty()
+           && (!jobs[key].head().watcher || jobs[key].head().watcher->isFinished())) {
+        Job job = jobs[key].dequeue();
+        job.deliver();
+        if (job.watcher) {
+            job.watcher->deleteLater();
+        }
+    }
+
+    if (jobs.contains(key) && jobs[key].isEmpty()) {
+        jobs.remove(key);
+    }
+}
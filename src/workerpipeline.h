@@ -0,0 +1,54 @@
+#ifndef WORKERPIPELINE_H
+#define WORKERPIPELINE_H
+
+#include <functional>
+
+#include <QObject>
+#include <QHash>
+#include <QQueue>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
+
+// Runs work on the global thread pool and hands the result back on the
+// thread that owns the pipeline. Results of jobs sharing a key are
+// delivered in the order the jobs were submitted, and post() runs a
+// function in that same order without any work of its own.
+class WorkerPipeline : public QObject
+{
+    Q_OBJECT
+public:
+    explicit WorkerPipeline(QObject *parent = 0);
+
+    void post(const QString &key, std::function<void()> done);
+    void waitForDone();
+
+    template <typename T>
+    void run(const QString &key, std::function<T()> work, std::function<void(const T&)> done) {
+        QFutureWatcher<T> *watcher = new QFutureWatcher<T>(this);
+
+        Job job;
+        job.watcher = watcher;
+        job.deliver = [watcher,done]() {
+            done(watcher->result());
+        };
+        jobs[key].enqueue(job);
+
+        connect(watcher, &QFutureWatcherBase::finished, [key,this]() {
+            flush(key);
+        });
+        watcher->setFuture(QtConcurrent::run(work));
+    }
+
+private:
+    struct Job {
+        // Null for posted functions, which are ready at once
+        QFutureWatcherBase *watcher;
+        std::function<void()> deliver;
+    };
+
+    void flush(const QString &key);
+
+    QHash<QString,QQueue<Job> > jobs;
+};
+
+#endif // WORKERPIPELINE_H
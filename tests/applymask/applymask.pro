@@ -0,0 +1,14 @@
+# Standalone check of QtWebsocket::applyMask against byte-wise masking,
+# with a benchmark of both. Not part of the app build:
+#   qmake tests/applymask && make check
+TARGET = tst_applymask
+CONFIG += console testcase
+CONFIG -= app_bundle
+QT = core testlib
+
+INCLUDEPATH += ../../src/QtWebsocket
+
+SOURCES += tst_applymask.cpp \
+    ../../src/QtWebsocket/functions.cpp
+
+HEADERS += ../../src/QtWebsocket/functions.h
@@ -0,0 +1,133 @@
+#include <QtTest/QtTest>
+#include <QByteArray>
+
+#include "functions.h"
+
+// The masking loop QWsFrame used before applyMask
+static void applyMaskByteWise(char* data, qint64 size, const char* maskingKey, qint64 offset)
+{
+	for (qint64 i = 0; i < size; i++)
+	{
+		data[i] ^= maskingKey[(offset + i) % 4];
+	}
+}
+
+static QByteArray payload(int size)
+{
+	QByteArray data(size, Qt::Uninitialized);
+	for (int i = 0; i < size; i++)
+	{
+		data[i] = char(i * 131 + 7);
+	}
+	return data;
+}
+
+class TestApplyMask : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void matchesByteWise_data();
+	void matchesByteWise();
+	void unmasksInPieces();
+	void benchmark_data();
+	void benchmark();
+};
+
+void TestApplyMask::matchesByteWise_data()
+{
+	QTest::addColumn<int>("alignment");
+	QTest::addColumn<int>("size");
+	QTest::addColumn<int>("offset");
+
+	const int sizes[] = { 0, 1, 3, 4, 7, 8, 9, 15, 16, 17, 31, 33, 63, 65, 255, 1021, 4099 };
+	for (int alignment = 0; alignment < 16; alignment += 3)
+	{
+		for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+		{
+			for (int offset = 0; offset < 8; offset++)
+			{
+				QTest::newRow(qPrintable(QString("a%1 s%2 o%3").arg(alignment).arg(sizes[s]).arg(offset)))
+					<< alignment << sizes[s] << offset;
+			}
+		}
+	}
+}
+
+void TestApplyMask::matchesByteWise()
+{
+	QFETCH(int, alignment);
+	QFETCH(int, size);
+	QFETCH(int, offset);
+
+	const char key[4] = { char(0x12), char(0xa7), char(0x5c), char(0xf0) };
+
+	// Padding around the payload shows writes outside of it
+	QByteArray expected = payload(size + 32);
+	QByteArray actual = expected;
+
+	applyMaskByteWise(expected.data() + alignment, size, key, offset);
+	QtWebsocket::applyMask(actual.data() + alignment, size, key, offset);
+
+	QCOMPARE(actual, expected);
+}
+
+void TestApplyMask::unmasksInPieces()
+{
+	// Frames are unmasked as their payload arrives, in pieces of any size
+	const char key[4] = { char(0x01), char(0x80), char(0x7f), char(0xff) };
+	QByteArray expected = payload(5000);
+	QByteArray actual = expected;
+
+	applyMaskByteWise(expected.data(), expected.size(), key, 0);
+
+	const int pieces[] = { 1, 7, 16, 3, 100, 33, 2048, 9 };
+	qint64 position = 0;
+	for (int i = 0; position < actual.size(); i++)
+	{
+		qint64 size = qMin<qint64>(pieces[i % 8], actual.size() - position);
+		QtWebsocket::applyMask(actual.data() + position, size, key, position);
+		position += size;
+	}
+
+	QCOMPARE(actual, expected);
+}
+
+void TestApplyMask::benchmark_data()
+{
+	QTest::addColumn<bool>("byteWise");
+	QTest::addColumn<int>("size");
+
+	QTest::newRow("byte-wise 125 B") << true << 125;
+	QTest::newRow("applyMask 125 B") << false << 125;
+	QTest::newRow("byte-wise 64 KiB") << true << 65536;
+	QTest::newRow("applyMask 64 KiB") << false << 65536;
+	QTest::newRow("byte-wise 4 MiB") << true << 4 * 1024 * 1024;
+	QTest::newRow("applyMask 4 MiB") << false << 4 * 1024 * 1024;
+}
+
+void TestApplyMask::benchmark()
+{
+	QFETCH(bool, byteWise);
+	QFETCH(int, size);
+
+	const char key[4] = { char(0x12), char(0xa7), char(0x5c), char(0xf0) };
+	QByteArray data = payload(size + 1);
+
+	// Start one byte in, as a payload after a frame header usually does
+	QBENCHMARK
+	{
+		if (byteWise)
+		{
+			applyMaskByteWise(data.data() + 1, size, key, 0);
+		}
+		else
+		{
+			QtWebsocket::applyMask(data.data() + 1, size, key, 0);
+		}
+	}
+}
+
+QTEST_APPLESS_MAIN(TestApplyMask)
+
+#include "tst_applymask.moc"
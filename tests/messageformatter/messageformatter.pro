@@ -0,0 +1,28 @@
+# Checks of MessageFormatter against the regular expression versions it
+# replaced, with benchmarks of both. Not part of the app build:
+#   qmake tests/messageformatter && make check
+TARGET = tst_messageformatter
+CONFIG += console testcase
+CONFIG -= app_bundle
+QT = core testlib
+
+# Emoji lookup table generated from data/emoji.json
+EMOJI_JSON = ../../data/emoji.json
+emojitable.input = EMOJI_JSON
+emojitable.output = $$OUT_PWD/emojitable.h
+emojitable.commands = python $$PWD/../../data/emojitable.py ${QMAKE_FILE_IN} ${QMAKE_FILE_OUT}
+emojitable.variable_out = HEADERS
+emojitable.CONFIG += no_link target_predeps
+QMAKE_EXTRA_COMPILERS += emojitable
+INCLUDEPATH += $$OUT_PWD ../../src
+
+OTHER_FILES += markdown.json
+
+SOURCES += tst_messageformatter.cpp \
+    ../../src/messageformatter.cpp \
+    ../../src/storage.cpp \
+    ../../src/slacktimestamp.cpp
+
+HEADERS += ../../src/messageformatter.h \
+    ../../src/storage.h \
+    ../../src/slacktimestamp.h
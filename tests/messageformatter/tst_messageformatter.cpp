@@ -0,0 +1,343 @@
+#include <QtTest/QtTest>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QRegularExpression>
+#include <QString>
+
+#include <algorithm>
+
+#include "messageformatter.h"
+
+// The regular expression version of MessageFormatter::replaceEmoji
+static void oldReplaceEmoji(QString& message)
+{
+	QRegularExpression emojiPattern(":([\\w\\+\\-]+):(:[\\w\\+\\-]+:)?[\\?\\.!,]?");
+	QRegularExpressionMatchIterator i = emojiPattern.globalMatch(message);
+
+	while (i.hasNext())
+	{
+		QRegularExpressionMatch match = i.next();
+		QString name = match.captured(1);
+		const char* image = MessageFormatter::emojiImage(match.capturedRef(1));
+
+		if (image)
+		{
+			QString emoji = QString("<img src=\"http://emojistatic.github.io/images/32/") + QLatin1String(image) + "\" alt=\"" + name + "\" align=\"bottom\" width=\"64\" height=\"64\" />";
+			message.replace(":" + name + ":", emoji);
+		}
+	}
+}
+
+// The regular expression versions of replaceMarkdown and
+// replaceSpecialCharacters, with the inline passes in their original order
+static const char* const oldInlinePatterns[] = {
+	"(^|\\s)_([^_]+)_(\\s|\\.|\\?|!|,|$)",
+	"(^|\\s)\\*([^\\*]+)\\*(\\s|\\.|\\?|!|,|$)",
+	"(^|\\s)~([^~]+)~(\\s|\\.|\\?|!|,|$)",
+	"(^|\\s)`([^`]+)`(\\s|\\.|\\?|!|,|$)"
+};
+
+static const char* const oldInlineReplacements[] = {
+	"\\1<i>\\2</i>\\3",
+	"\\1<b>\\2</b>\\3",
+	"\\1<s>\\2</s>\\3",
+	"\\1<code>\\2</code>\\3"
+};
+
+static void oldReplaceInlineMarkup(QString& message, int pass)
+{
+	message.replace(QRegularExpression(oldInlinePatterns[pass]), oldInlineReplacements[pass]);
+}
+
+static void oldReplaceCodeBlocks(QString& message)
+{
+	message.replace(QRegularExpression("```([^`]+)```"), "<br/><code>\\1</code><br/>");
+}
+
+static void oldReplaceMarkdown(QString& message)
+{
+	for (int pass = 0; pass < 4; pass++)
+	{
+		oldReplaceInlineMarkup(message, pass);
+	}
+	oldReplaceCodeBlocks(message);
+	message.replace(QRegularExpression("\n"), "<br/>");
+}
+
+static void oldReplaceSpecialCharacters(QString& message)
+{
+	message.replace(QRegularExpression("&gt;"), ">");
+	message.replace(QRegularExpression("&lt;"), "<");
+	message.replace(QRegularExpression("&amp;"), "&");
+}
+
+static QString emoji(const char* name, const char* image)
+{
+	return QString("<img src=\"http://emojistatic.github.io/images/32/%1\" alt=\"%2\" align=\"bottom\" width=\"64\" height=\"64\" />")
+		.arg(QLatin1String(image), QLatin1String(name));
+}
+
+class TestMessageFormatter : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void emojiMatchesOld_data();
+	void emojiMatchesOld();
+	void emojiChanges_data();
+	void emojiChanges();
+	void emojiBenchmark_data();
+	void emojiBenchmark();
+	void markdownMatchesOld_data();
+	void markdownMatchesOld();
+	void specialCharactersMatchesOld_data();
+	void specialCharactersMatchesOld();
+	void inlineMarkupInAnyOrder_data();
+	void inlineMarkupInAnyOrder();
+	void codeBlocksAfterInlineMarkup();
+	void markdownBenchmark_data();
+	void markdownBenchmark();
+};
+
+void TestMessageFormatter::emojiMatchesOld_data()
+{
+	QTest::addColumn<QString>("message");
+
+	QTest::newRow("no emoji") << "plain text";
+	QTest::newRow("only emoji") << ":smile:";
+	QTest::newRow("repeated") << "a :smile: b :smile:";
+	QTest::newRow("repeated adjacent") << ":smile::smile:";
+	QTest::newRow("separated") << ":smile: :heart:";
+	QTest::newRow("plus sign") << ":+1: done!";
+	QTest::newRow("punctuation") << ":smile:, ok? :tada:.";
+	QTest::newRow("unknown") << ":not-an-emoji:";
+	QTest::newRow("unknown then emoji") << ":not-an-emoji: :smile:";
+	QTest::newRow("colon after emoji") << ":smile:heart:";
+	QTest::newRow("colon after unknown") << "at 12:30:tada:";
+	QTest::newRow("empty name") << ":: :";
+	QTest::newRow("time") << "meet at 10:30";
+	QTest::newRow("url") << "http://example.com:8080/a:b";
+	QTest::newRow("skin tone alone") << ":skin-tone-2:";
+	QTest::newRow("non-ASCII name") << ":smíle: :smile:";
+	QTest::newRow("dense") << "lunch :pizza: :pizza: :beer: :+1: :tada: :eyes: :wave:";
+}
+
+void TestMessageFormatter::emojiMatchesOld()
+{
+	QFETCH(QString, message);
+
+	QString expected = message;
+	oldReplaceEmoji(expected);
+	QString actual = message;
+	MessageFormatter::replaceEmoji(actual);
+
+	QCOMPARE(actual, expected);
+}
+
+void TestMessageFormatter::emojiChanges_data()
+{
+	QTest::addColumn<QString>("message");
+	QTest::addColumn<QString>("oldResult");
+	QTest::addColumn<QString>("result");
+
+	// The images have a single tone, the modifier is no longer shown as text
+	QTest::newRow("skin tone")
+		<< "hi :wave::skin-tone-2:"
+		<< "hi " + emoji("wave", "1f44b.png") + ":skin-tone-2:"
+		<< "hi " + emoji("wave", "1f44b.png");
+
+	// The expression swallowed an emoji that directly followed another one
+	QTest::newRow("adjacent emoji")
+		<< ":smile::heart:"
+		<< emoji("smile", "1f604.png") + ":heart:"
+		<< emoji("smile", "1f604.png") + emoji("heart", "2764-fe0f.png");
+	QTest::newRow("adjacent to unknown")
+		<< ":custom-emoji::tada:"
+		<< ":custom-emoji::tada:"
+		<< ":custom-emoji:" + emoji("tada", "1f389.png");
+}
+
+void TestMessageFormatter::emojiChanges()
+{
+	QFETCH(QString, message);
+	QFETCH(QString, oldResult);
+	QFETCH(QString, result);
+
+	QString old = message;
+	oldReplaceEmoji(old);
+	QCOMPARE(old, oldResult);
+
+	QString actual = message;
+	MessageFormatter::replaceEmoji(actual);
+	QCOMPARE(actual, result);
+}
+
+void TestMessageFormatter::emojiBenchmark_data()
+{
+	QTest::addColumn<bool>("old");
+	QTest::addColumn<QString>("message");
+
+	QString dense = QString(":+1: :tada: :smile: :heart: :pizza: :beer: :eyes: :wave: ").repeated(8);
+	QString sparse = "Sounds good, shipping it after lunch :+1: see the notes at http://example.com:8080/notes";
+	QString none = "Can someone look at build 4812? It fails on armv7hl only, at 10:30 this morning.";
+
+	QTest::newRow("regex dense") << true << dense;
+	QTest::newRow("single pass dense") << false << dense;
+	QTest::newRow("regex sparse") << true << sparse;
+	QTest::newRow("single pass sparse") << false << sparse;
+	QTest::newRow("regex none") << true << none;
+	QTest::newRow("single pass none") << false << none;
+}
+
+void TestMessageFormatter::emojiBenchmark()
+{
+	QFETCH(bool, old);
+	QFETCH(QString, message);
+
+	QBENCHMARK
+	{
+		QString result = message;
+		if (old)
+		{
+			oldReplaceEmoji(result);
+		}
+		else
+		{
+			MessageFormatter::replaceEmoji(result);
+		}
+	}
+}
+
+void TestMessageFormatter::markdownMatchesOld_data()
+{
+	QTest::addColumn<QString>("message");
+
+	QFile file(QFINDTESTDATA("markdown.json"));
+	QVERIFY(file.open(QIODevice::ReadOnly));
+	QJsonArray corpus = QJsonDocument::fromJson(file.readAll()).array();
+	QVERIFY(!corpus.isEmpty());
+
+	for (int i = 0; i < corpus.size(); i++)
+	{
+		QTest::newRow(qPrintable(QString("corpus %1").arg(i))) << corpus.at(i).toString();
+	}
+}
+
+void TestMessageFormatter::markdownMatchesOld()
+{
+	QFETCH(QString, message);
+
+	QString expected = message;
+	oldReplaceMarkdown(expected);
+	QString actual = message;
+	MessageFormatter::replaceMarkdown(actual);
+
+	QCOMPARE(actual, expected);
+}
+
+void TestMessageFormatter::specialCharactersMatchesOld_data()
+{
+	markdownMatchesOld_data();
+}
+
+void TestMessageFormatter::specialCharactersMatchesOld()
+{
+	QFETCH(QString, message);
+
+	QString expected = message;
+	oldReplaceSpecialCharacters(expected);
+	QString actual = message;
+	MessageFormatter::replaceSpecialCharacters(actual);
+
+	QCOMPARE(actual, expected);
+}
+
+void TestMessageFormatter::inlineMarkupInAnyOrder_data()
+{
+	markdownMatchesOld_data();
+}
+
+void TestMessageFormatter::inlineMarkupInAnyOrder()
+{
+	// The inline passes do not affect each other, which is what lets
+	// replaceMarkdown find all inline markup in one scan
+	QFETCH(QString, message);
+
+	QString expected = message;
+	for (int pass = 0; pass < 4; pass++)
+	{
+		oldReplaceInlineMarkup(expected, pass);
+	}
+
+	int order[] = { 0, 1, 2, 3 };
+	while (std::next_permutation(order, order + 4))
+	{
+		QString actual = message;
+		for (int pass = 0; pass < 4; pass++)
+		{
+			oldReplaceInlineMarkup(actual, order[pass]);
+		}
+		QCOMPARE(actual, expected);
+	}
+}
+
+void TestMessageFormatter::codeBlocksAfterInlineMarkup()
+{
+	// A block holding inline code is only found once the inline backticks
+	// are replaced, so code blocks stay a second pass over the inline output
+	QString message = "```x `y` z```";
+
+	QString blocksFirst = message;
+	oldReplaceCodeBlocks(blocksFirst);
+	for (int pass = 0; pass < 4; pass++)
+	{
+		oldReplaceInlineMarkup(blocksFirst, pass);
+	}
+	QCOMPARE(blocksFirst, QString("```x <code>y</code> z```"));
+
+	QString expected = message;
+	oldReplaceMarkdown(expected);
+	QCOMPARE(expected, QString("<br/><code>x <code>y</code> z</code><br/>"));
+
+	QString actual = message;
+	MessageFormatter::replaceMarkdown(actual);
+	QCOMPARE(actual, expected);
+}
+
+void TestMessageFormatter::markdownBenchmark_data()
+{
+	QTest::addColumn<bool>("old");
+	QTest::addColumn<QString>("message");
+
+	QString markup = "Build _4812_ *failed* on `armv7hl`, see ~yesterday~ today's log:\n```\nld: cannot find -lsailfishapp\n```\nThanks!";
+	QString plain = "Can someone look at build 4812? It fails on armv7hl only, at 10:30 this morning.";
+
+	QTest::newRow("regex markup") << true << markup;
+	QTest::newRow("scanner markup") << false << markup;
+	QTest::newRow("regex plain") << true << plain;
+	QTest::newRow("scanner plain") << false << plain;
+}
+
+void TestMessageFormatter::markdownBenchmark()
+{
+	QFETCH(bool, old);
+	QFETCH(QString, message);
+
+	QBENCHMARK
+	{
+		QString result = message;
+		if (old)
+		{
+			oldReplaceMarkdown(result);
+		}
+		else
+		{
+			MessageFormatter::replaceMarkdown(result);
+		}
+	}
+}
+
+QTEST_APPLESS_MAIN(TestMessageFormatter)
+
+#include "tst_messageformatter.moc"
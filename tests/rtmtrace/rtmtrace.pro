@@ -0,0 +1,28 @@
+# Replays a recorded RTM event trace through QWsSocket and SlackStream and
+# counts the heap allocations made per event, for UTF-8 text frames and for
+# the QString frames they replaced. Not part of the app build:
+#   qmake tests/rtmtrace && make check
+TARGET = tst_rtmtrace
+CONFIG += console testcase
+CONFIG -= app_bundle
+QT = core network testlib
+
+# SlackStream logs every message, which would dominate the counts
+DEFINES += QT_NO_DEBUG_OUTPUT
+
+INCLUDEPATH += ../../src ../../src/QtWebsocket
+
+SOURCES += tst_rtmtrace.cpp \
+    ../../src/slackstream.cpp \
+    ../../src/QtWebsocket/QWsSocket.cpp \
+    ../../src/QtWebsocket/QWsFrame.cpp \
+    ../../src/QtWebsocket/QWsHandshake.cpp \
+    ../../src/QtWebsocket/functions.cpp
+
+HEADERS += ../../src/slackstream.h \
+    ../../src/QtWebsocket/QWsSocket.h \
+    ../../src/QtWebsocket/QWsFrame.h \
+    ../../src/QtWebsocket/QWsHandshake.h \
+    ../../src/QtWebsocket/functions.h
+
+OTHER_FILES += rtm.trace
@@ -0,0 +1,311 @@
+#include <QtTest/QtTest>
+#include <QByteArray>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTcpSocket>
+
+#include <cstdlib>
+
+#include "QWsSocket.h"
+#include "slackstream.h"
+
+// Heap allocations are counted by wrapping the glibc allocator. QByteArray,
+// QString and the JSON classes all allocate through malloc and realloc.
+#ifdef __GLIBC__
+#define COUNT_ALLOCATIONS
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+static bool counting = false;
+static qint64 allocations = 0;
+static qint64 allocatedBytes = 0;
+
+static void count(size_t size)
+{
+	if (counting)
+	{
+		allocations++;
+		allocatedBytes += size;
+	}
+}
+
+extern "C" void* malloc(size_t size)
+{
+	count(size);
+	return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count_, size_t size)
+{
+	count(count_ * size);
+	return __libc_calloc(count_, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size)
+{
+	count(size);
+	return __libc_realloc(ptr, size);
+}
+#endif
+
+// A connected socket that hands out a recorded byte stream in TCP sized
+// pieces, so that the websocket is replayed without a network or event loop
+class TraceSocket : public QTcpSocket
+{
+public:
+	explicit TraceSocket(const QByteArray& data) :
+		stream(data),
+		position(0),
+		limit(0)
+	{
+		setOpenMode(QIODevice::ReadWrite | QIODevice::Unbuffered);
+		setSocketState(QAbstractSocket::ConnectedState);
+	}
+
+	bool deliver(int size)
+	{
+		if (limit >= stream.size())
+		{
+			return false;
+		}
+		limit = qMin(limit + size, stream.size());
+		emit readyRead();
+		return true;
+	}
+
+	void hangUp()
+	{
+		setSocketState(QAbstractSocket::UnconnectedState);
+		emit stateChanged(QAbstractSocket::UnconnectedState);
+	}
+
+	qint64 bytesAvailable() const
+	{
+		return limit - position;
+	}
+
+protected:
+	qint64 readData(char* data, qint64 maxSize)
+	{
+		qint64 size = qMin(maxSize, bytesAvailable());
+		memcpy(data, stream.constData() + position, size);
+		position += size;
+		return size;
+	}
+
+	qint64 writeData(const char*, qint64 size)
+	{
+		return size;
+	}
+
+private:
+	const QByteArray stream;
+	int position;
+	int limit;
+};
+
+// SlackStream::handleMessage as it was before text frames were passed on as
+// UTF-8: the socket decodes every frame to QString and it is encoded back
+class QStringStream : public QObject
+{
+	Q_OBJECT
+
+signals:
+	void messageReceived(QJsonObject message);
+
+public slots:
+	void handleMessage(QString message)
+	{
+		QJsonParseError error;
+		QJsonDocument document = QJsonDocument::fromJson(message.toUtf8(), &error);
+		if (error.error != QJsonParseError::NoError)
+		{
+			return;
+		}
+
+		emit messageReceived(document.object());
+	}
+};
+
+class TestRtmTrace : public QObject
+{
+	Q_OBJECT
+
+public slots:
+	void collect(const QJsonObject& message);
+
+private slots:
+	void initTestCase();
+	void replay_data();
+	void replay();
+	void allocationsDrop();
+
+private:
+	struct Result
+	{
+		qint64 allocations;
+		qint64 bytes;
+	};
+
+	Result run(bool utf8);
+
+	QList<QByteArray> events;
+	QByteArray stream;
+	QList<QJsonObject> received;
+};
+
+static const int segmentSize = 1448;
+static const int fragmentSize = 4096;
+
+static QByteArray frame(bool final, char opcode, const QByteArray& payload)
+{
+	QByteArray header;
+	header.append(char((final ? 0x80 : 0x00) | opcode));
+	if (payload.size() < 126)
+	{
+		header.append(char(payload.size()));
+	}
+	else if (payload.size() < 65536)
+	{
+		header.append(char(126));
+		header.append(char(payload.size() >> 8));
+		header.append(char(payload.size()));
+	}
+	else
+	{
+		header.append(char(127));
+		for (int shift = 56; shift >= 0; shift -= 8)
+		{
+			header.append(char(quint64(payload.size()) >> shift));
+		}
+	}
+	return header + payload;
+}
+
+void TestRtmTrace::initTestCase()
+{
+	// One RTM event per line, as the server sends them
+	QFile trace(QFINDTESTDATA("rtm.trace"));
+	QVERIFY(trace.open(QIODevice::ReadOnly));
+	while (!trace.atEnd())
+	{
+		QByteArray line = trace.readLine();
+		if (line.endsWith('\n'))
+		{
+			line.chop(1);
+		}
+		if (!line.isEmpty())
+		{
+			events.append(line);
+		}
+	}
+	QVERIFY(!events.isEmpty());
+
+	// Server frames are unmasked; large events arrive fragmented
+	foreach (const QByteArray& event, events)
+	{
+		for (int offset = 0; offset < event.size(); offset += fragmentSize)
+		{
+			bool final = offset + fragmentSize >= event.size();
+			char opcode = offset == 0 ? char(QtWebsocket::OpText) : char(QtWebsocket::OpContinue);
+			stream.append(frame(final, opcode, event.mid(offset, fragmentSize)));
+		}
+	}
+}
+
+void TestRtmTrace::collect(const QJsonObject& message)
+{
+	received.append(message);
+}
+
+TestRtmTrace::Result TestRtmTrace::run(bool utf8)
+{
+	received.clear();
+	received.reserve(events.size());
+
+	TraceSocket* socket = new TraceSocket(stream);
+	QtWebsocket::QWsSocket webSocket(0, socket, QtWebsocket::WS_V13);
+	SlackStream slackStream;
+	QStringStream stringStream;
+
+	if (utf8)
+	{
+		connect(&webSocket, SIGNAL(textFrameReceived(QByteArray)), &slackStream, SLOT(handleMessage(QByteArray)));
+		connect(&slackStream, SIGNAL(messageReceived(QJsonObject)), this, SLOT(collect(QJsonObject)));
+	}
+	else
+	{
+		connect(&webSocket, SIGNAL(frameReceived(QString)), &stringStream, SLOT(handleMessage(QString)));
+		connect(&stringStream, SIGNAL(messageReceived(QJsonObject)), this, SLOT(collect(QJsonObject)));
+	}
+
+	Result result = { 0, 0 };
+#ifdef COUNT_ALLOCATIONS
+	allocations = 0;
+	allocatedBytes = 0;
+	counting = true;
+#endif
+	while (socket->deliver(segmentSize))
+	{
+	}
+#ifdef COUNT_ALLOCATIONS
+	counting = false;
+	result.allocations = allocations;
+	result.bytes = allocatedBytes;
+#endif
+
+	socket->hangUp();
+	return result;
+}
+
+void TestRtmTrace::replay_data()
+{
+	QTest::addColumn<bool>("utf8");
+
+	QTest::newRow("QString frames") << false;
+	QTest::newRow("UTF-8 frames") << true;
+}
+
+void TestRtmTrace::replay()
+{
+	QFETCH(bool, utf8);
+
+	run(utf8);
+
+	QCOMPARE(received.size(), events.size());
+	for (int i = 0; i < events.size(); i++)
+	{
+		QCOMPARE(received.at(i), QJsonDocument::fromJson(events.at(i)).object());
+	}
+}
+
+void TestRtmTrace::allocationsDrop()
+{
+#ifndef COUNT_ALLOCATIONS
+	QSKIP("Allocations are only counted with glibc");
+#else
+	// First runs warm up lazily created state, such as metatypes
+	run(false);
+	run(true);
+
+	Result before = run(false);
+	Result after = run(true);
+
+	qWarning("%d events, %d bytes of frames", events.size(), stream.size());
+	qWarning("QString frames: %.2f allocations and %.0f bytes per event",
+		double(before.allocations) / events.size(), double(before.bytes) / events.size());
+	qWarning("UTF-8 frames:   %.2f allocations and %.0f bytes per event",
+		double(after.allocations) / events.size(), double(after.bytes) / events.size());
+
+	// Each event used to be decoded to UTF-16 and encoded back to UTF-8
+	QVERIFY(after.allocations + 2 * events.size() <= before.allocations);
+	QVERIFY(after.bytes < before.bytes);
+#endif
+}
+
+QTEST_GUILESS_MAIN(TestRtmTrace)
+
+#include "tst_rtmtrace.moc"